@@ -51,11 +51,14 @@
 #include "gromacs/math/densityfittingforce.h"
 #include "gromacs/math/exponentialmovingaverage.h"
 #include "gromacs/math/gausstransform.h"
+#include "gromacs/mdlib/gmx_omp_nthreads.h"
 #include "gromacs/mdtypes/commrec.h"
 #include "gromacs/mdtypes/enerdata.h"
 #include "gromacs/mdtypes/forceoutput.h"
 #include "gromacs/mdtypes/iforceprovider.h"
 #include "gromacs/pbcutil/pbc.h"
+#include "gromacs/utility/exceptions.h"
+#include "gromacs/utility/gmxomp.h"
 
 #include "densityfittingamplitudelookup.h"
 #include "densityfittingparameters.h"
@@ -114,7 +117,8 @@ private:
     GaussianSpreadKernelParameters::Shape spreadKernel_;
     GaussTransform3D                      gaussTransform_;
     DensitySimilarityMeasure              measure_;
-    DensityFittingForce                   densityFittingForce_;
+    //! Force evaluators, one per OpenMP thread, because they hold scratch memory
+    std::vector<DensityFittingForce> densityFittingForces_;
     //! the local atom coordinates transformed into the grid coordinate system
     std::vector<RVec>             transformedCoordinates_;
     std::vector<RVec>             forces_;
@@ -144,7 +148,7 @@ DensityFittingForceProvider::Impl::Impl(const DensityFittingParameters&
                                    transformationToDensityLattice.scaleOperationOnly())),
     gaussTransform_(referenceDensity.extents(), spreadKernel_),
     measure_(parameters.similarityMeasureMethod_, referenceDensity),
-    densityFittingForce_(spreadKernel_),
+    densityFittingForces_(1, DensityFittingForce(spreadKernel_)),
     transformedCoordinates_(localAtomSet_.numAtomsLocal()),
     amplitudeLookup_(parameters_.amplitudeLookupMethod_),
     transformationToDensityLattice_(transformationToDensityLattice),
@@ -228,13 +232,8 @@ void DensityFittingForceProvider::Impl::calculateForces(const ForceProviderInput
         }
     }
 
-    auto amplitudeIterator = amplitudes.cbegin();
-
-    for (const auto& r : transformedCoordinates_)
-    {
-        gaussTransform_.add({ r, *amplitudeIterator });
-        ++amplitudeIterator;
-    }
+    const int numThreads = gmx_omp_nthreads_get(emntDefault);
+    gaussTransform_.add(transformedCoordinates_, amplitudes, numThreads);
 
     // communicate grid
     if (havePPDomainDecomposition(&forceProviderInput.cr_))
@@ -244,16 +243,27 @@ void DensityFittingForceProvider::Impl::calculateForces(const ForceProviderInput
                  gaussTransform_.view().data(), &forceProviderInput.cr_);
     }
 
-    // calculate grid derivative
+    // calculate grid derivative, the similarity below uses the same threads
+    measure_.setNumThreads(numThreads);
     const DensitySimilarityMeasure::density& densityDerivative =
             measure_.gradient(gaussTransform_.constView());
     // calculate forces
     forces_.resize(localAtomSet_.numAtomsLocal());
-    std::transform(
-            std::begin(transformedCoordinates_), std::end(transformedCoordinates_), std::begin(amplitudes),
-            std::begin(forces_), [&densityDerivative, this](const RVec r, real amplitude) {
-                return densityFittingForce_.evaluateForce({ r, amplitude }, densityDerivative);
-            });
+    if (ssize(densityFittingForces_) < numThreads)
+    {
+        densityFittingForces_.resize(numThreads, densityFittingForces_[0]);
+    }
+    const int numAtomsLocal = localAtomSet_.numAtomsLocal();
+#pragma omp parallel for num_threads(numThreads) schedule(static)
+    for (int i = 0; i < numAtomsLocal; ++i)
+    {
+        try
+        {
+            forces_[i] = densityFittingForces_[gmx_omp_get_thread_num()].evaluateForce(
+                    { transformedCoordinates_[i], amplitudes[i] }, densityDerivative);
+        }
+        GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR
+    }
 
     transformationToDensityLattice_.scaleOperationOnly().inverseIgnoringZeroScale(forces_);
 
@@ -53,11 +53,13 @@
 #include <cstring>
 
 #include <algorithm>
+#include <vector>
 
 #include "gromacs/fileio/gmxfio.h"
 #include "gromacs/fileio/xvgr.h"
 #include "gromacs/gmxlib/network.h"
 #include "gromacs/math/utilities.h"
+#include "gromacs/mdlib/gmx_omp_nthreads.h"
 #include "gromacs/mdrunutility/multisim.h"
 #include "gromacs/mdtypes/awh_history.h"
 #include "gromacs/mdtypes/awh_params.h"
@@ -67,6 +69,7 @@
 #include "gromacs/utility/arrayref.h"
 #include "gromacs/utility/exceptions.h"
 #include "gromacs/utility/gmxassert.h"
+#include "gromacs/utility/gmxomp.h"
 #include "gromacs/utility/smalloc.h"
 #include "gromacs/utility/stringutil.h"
 
@@ -200,6 +203,37 @@ double freeEnergyMinimumValue(gmx::ArrayRef<const PointState> pointState)
     return fMin;
 }
 
+/*! \brief
+ * Returns the number of OpenMP threads to use for a loop over independent points.
+ *
+ * Loops over few points are not worth the threading overhead.
+ *
+ * \param[in] numPoints  The number of points in the loop.
+ */
+int numThreadsForPointLoop(size_t numPoints)
+{
+    const size_t c_minNumPointsPerThread = 500;
+
+    return std::max(1, std::min(gmx_omp_nthreads_get(emntDefault),
+                                static_cast<int>(numPoints / c_minNumPointsPerThread)));
+}
+
+/*! \brief
+ * Returns whether every point occurs at most once in the update list.
+ *
+ * The points in the update list are updated in parallel. Each update only
+ * changes the state of its own point, so this is thread safe as long as
+ * no point occurs twice in the list.
+ *
+ * \param[in] updateList  List of points to update.
+ */
+gmx_unused bool updateListHasUniquePoints(gmx::ArrayRef<const int> updateList)
+{
+    std::vector<int> sortedList(updateList.begin(), updateList.end());
+    std::sort(sortedList.begin(), sortedList.end());
+    return std::adjacent_find(sortedList.begin(), sortedList.end()) == sortedList.end();
+}
+
 /*! \brief
  * Find and return the log of the probability weight of a point given a coordinate value.
  *
@@ -254,26 +288,33 @@ void BiasState::calcConvolvedPmf(const std::vector<DimParams>& dimParams,
     std::vector<float> pmf(numPoints);
     getPmf(pmf);
 
+    /* The convolution for each point is independent */
+    const int numThreads = numThreadsForPointLoop(numPoints);
+#pragma omp parallel for num_threads(numThreads) schedule(static)
     for (size_t m = 0; m < numPoints; m++)
     {
-        double           freeEnergyWeights = 0;
-        const GridPoint& point             = grid.point(m);
-        for (auto& neighbor : point.neighbor)
+        try
         {
-            /* The negative PMF is a positive bias. */
-            double biasNeighbor = -pmf[neighbor];
-
-            /* Add the convolved PMF weights for the neighbors of this point.
-               Note that this function only adds point within the target > 0 region.
-               Sum weights, take the logarithm last to get the free energy. */
-            double logWeight = biasedLogWeightFromPoint(dimParams, points_, grid, neighbor,
-                                                        biasNeighbor, point.coordValue);
-            freeEnergyWeights += std::exp(logWeight);
-        }
+            double           freeEnergyWeights = 0;
+            const GridPoint& point             = grid.point(m);
+            for (auto& neighbor : point.neighbor)
+            {
+                /* The negative PMF is a positive bias. */
+                double biasNeighbor = -pmf[neighbor];
+
+                /* Add the convolved PMF weights for the neighbors of this point.
+                   Note that this function only adds point within the target > 0 region.
+                   Sum weights, take the logarithm last to get the free energy. */
+                double logWeight = biasedLogWeightFromPoint(dimParams, points_, grid, neighbor,
+                                                            biasNeighbor, point.coordValue);
+                freeEnergyWeights += std::exp(logWeight);
+            }
 
-        GMX_RELEASE_ASSERT(freeEnergyWeights > 0,
-                           "Attempting to do log(<= 0) in AWH convolved PMF calculation.");
-        (*convolvedPmf)[m] = -std::log(static_cast<float>(freeEnergyWeights));
+            GMX_RELEASE_ASSERT(freeEnergyWeights > 0,
+                               "Attempting to do log(<= 0) in AWH convolved PMF calculation.");
+            (*convolvedPmf)[m] = -std::log(static_cast<float>(freeEnergyWeights));
+        }
+        GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR
     }
 }
 
@@ -737,30 +778,28 @@ void sumHistograms(gmx::ArrayRef<PointState> pointState,
         GMX_ASSERT(numSharedUpdate == multiSimComm->nsim,
                    "Sharing within a simulation is not implemented (yet)");
 
-        /* Collect the weights and counts in linear arrays to be able to use gmx_sumd_sim. */
-        std::vector<double> weightSum;
-        std::vector<double> coordVisits;
+        /* Collect the weights and counts in one linear array to be able to use a single
+           gmx_sumd_sim call, the weights first followed by the counts. */
+        const size_t        numLocal = localUpdateList.size();
+        std::vector<double> weightSumAndCoordVisits(2 * numLocal);
 
-        weightSum.resize(localUpdateList.size());
-        coordVisits.resize(localUpdateList.size());
-
-        for (size_t localIndex = 0; localIndex < localUpdateList.size(); localIndex++)
+        for (size_t localIndex = 0; localIndex < numLocal; localIndex++)
         {
             const PointState& ps = pointState[localUpdateList[localIndex]];
 
-            weightSum[localIndex]   = ps.weightSumIteration();
-            coordVisits[localIndex] = ps.numVisitsIteration();
+            weightSumAndCoordVisits[localIndex]            = ps.weightSumIteration();
+            weightSumAndCoordVisits[numLocal + localIndex] = ps.numVisitsIteration();
         }
 
-        sumOverSimulations(gmx::ArrayRef<double>(weightSum), commRecord, multiSimComm);
-        sumOverSimulations(gmx::ArrayRef<double>(coordVisits), commRecord, multiSimComm);
+        sumOverSimulations(gmx::ArrayRef<double>(weightSumAndCoordVisits), commRecord, multiSimComm);
 
         /* Transfer back the result */
-        for (size_t localIndex = 0; localIndex < localUpdateList.size(); localIndex++)
+        for (size_t localIndex = 0; localIndex < numLocal; localIndex++)
         {
             PointState& ps = pointState[localUpdateList[localIndex]];
 
-            ps.setPartialWeightAndCount(weightSum[localIndex], coordVisits[localIndex]);
+            ps.setPartialWeightAndCount(weightSumAndCoordVisits[localIndex],
+                                        weightSumAndCoordVisits[numLocal + localIndex]);
         }
     }
 
@@ -1109,22 +1148,33 @@ void BiasState::updateFreeEnergyAndAddSamplesToHistogram(const std::vector<DimPa
     setHistogramUpdateScaleFactors(params, newHistogramSize, histogramSize_.histogramSize(),
                                    &weightHistScalingNew, &logPmfsumScalingNew);
 
-    /* Update free energy and reference weight histogram for points in the update list. */
-    for (int pointIndex : *updateList)
-    {
-        PointState* pointStateToUpdate = &points_[pointIndex];
-
-        /* Do updates from previous update steps that were skipped because this point was at that time non-local. */
-        if (params.skipUpdates())
+    /* Update free energy and reference weight histogram for points in the update list.
+     * The points are updated independently, so large lists are split over threads.
+     * Both PointState update calls below only modify the point they are called on.
+     */
+    GMX_ASSERT(updateListHasUniquePoints(*updateList),
+               "Points should occur only once in the update list, as they are updated in parallel");
+    const int numThreads = numThreadsForPointLoop(updateList->size());
+    const int numUpdates = histogramSize_.numUpdates();
+#pragma omp parallel for num_threads(numThreads) schedule(static)
+    for (size_t i = 0; i < updateList->size(); i++)
+    {
+        try
         {
-            pointStateToUpdate->performPreviouslySkippedUpdates(params, histogramSize_.numUpdates(),
-                                                                weightHistScalingSkipped,
-                                                                logPmfsumScalingSkipped);
-        }
+            PointState* pointStateToUpdate = &points_[(*updateList)[i]];
+
+            /* Do updates from previous update steps that were skipped because this point was at that time non-local. */
+            if (params.skipUpdates())
+            {
+                pointStateToUpdate->performPreviouslySkippedUpdates(
+                        params, numUpdates, weightHistScalingSkipped, logPmfsumScalingSkipped);
+            }
 
-        /* Now do an update with new sampling data. */
-        pointStateToUpdate->updateWithNewSampling(params, histogramSize_.numUpdates(),
-                                                  weightHistScalingNew, logPmfsumScalingNew);
+            /* Now do an update with new sampling data. */
+            pointStateToUpdate->updateWithNewSampling(params, numUpdates, weightHistScalingNew,
+                                                      logPmfsumScalingNew);
+        }
+        GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR
     }
 
     /* Only update the histogram size after we are done with the local point updates */
@@ -1143,9 +1193,14 @@ void BiasState::updateFreeEnergyAndAddSamplesToHistogram(const std::vector<DimPa
 
     /* Update the bias. The bias is updated separately and last since it simply a function of
        the free energy and the target distribution and we want to avoid doing extra work. */
-    for (int pointIndex : *updateList)
+#pragma omp parallel for num_threads(numThreads) schedule(static)
+    for (size_t i = 0; i < updateList->size(); i++)
     {
-        points_[pointIndex].updateBias();
+        try
+        {
+            points_[(*updateList)[i]].updateBias();
+        }
+        GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR
     }
 
     /* Increase the update counter. */
@@ -43,6 +43,8 @@
 #include <cstring>
 #include <ctime>
 
+#include <algorithm>
+
 #include <memory>
 
 #include "gromacs/commandline/filenm.h"
@@ -58,6 +60,7 @@
 #include "gromacs/math/vectypes.h"
 #include "gromacs/mdlib/broadcaststructs.h"
 #include "gromacs/mdlib/constr.h"
+#include "gromacs/mdlib/gmx_omp_nthreads.h"
 #include "gromacs/mdlib/groupcoord.h"
 #include "gromacs/mdlib/stat.h"
 #include "gromacs/mdlib/update.h"
@@ -397,6 +400,65 @@ real projectx(const t_edpar& edi, rvec* xcoll, rvec* vec)
 
     return proj;
 }
+
+/*! \brief Returns the number of OpenMP threads for a loop over eigenvectors and ED atoms.
+ *
+ * Only uses multiple threads when the work, which is proportional to the
+ * number of eigenvectors times the number of atoms, is large enough.
+ * \param[in] edi Essential dynamics parameters
+ * \param[in] numEigenvectors The number of eigenvectors in the loop
+ */
+int numThreadsForEigenvectorLoop(const t_edpar& edi, int numEigenvectors)
+{
+    const int c_minNumPairsPerThread = 10000;
+
+    return std::max(1, std::min(gmx_omp_nthreads_get(emntDefault),
+                                numEigenvectors * edi.sav.nr / c_minNumPairsPerThread));
+}
+
+/*! \brief Computes the projections of coordinates onto all eigenvectors in a set.
+ * The projections are independent and are distributed over threads.
+ * \param[in] edi Essential dynamics parameters
+ * \param[in] xcoll vector of atom coordinates
+ * \param[in] vec the eigenvectors to project onto
+ * \param[out] proj the projections, vec.neig elements
+ */
+void projectOntoEigenvectors(const t_edpar& edi, rvec* xcoll, const t_eigvec& vec, real* proj)
+{
+    const int numThreads = std::min(numThreadsForEigenvectorLoop(edi, vec.neig), vec.neig);
+#pragma omp parallel for num_threads(numThreads) schedule(static)
+    for (int i = 0; i < vec.neig; i++)
+    {
+        proj[i] = projectx(edi, xcoll, vec.vec[i]);
+    }
+}
+
+/*! \brief Adds a linear combination of eigenvectors to the coordinates.
+ * The atoms are distributed over threads. Each atom gets the eigenvector
+ * contributions added in order, so the result does not depend on the thread count.
+ * \param[in] edi Essential dynamics parameters
+ * \param[in] vec the eigenvectors
+ * \param[in] coefficients the coefficient for each eigenvector
+ * \param[in,out] xcoll vector of atom coordinates
+ */
+void addEigenvectorCombination(const t_edpar&  edi,
+                               const t_eigvec& vec,
+                               const real*     coefficients,
+                               rvec*           xcoll)
+{
+    const int numThreads = numThreadsForEigenvectorLoop(edi, vec.neig);
+#pragma omp parallel for num_threads(numThreads) schedule(static)
+    for (int j = 0; j < edi.sav.nr; j++)
+    {
+        for (int i = 0; i < vec.neig; i++)
+        {
+            rvec vec_dum;
+            svmul(coefficients[i], vec.vec[i][j], vec_dum);
+            rvec_inc(xcoll[j], vec_dum);
+        }
+    }
+}
+
 /*!\brief Project coordinates onto vector after substracting average position.
  * projection is stored in vec->refproj which is used for radacc, radfix,
  * radcon and center of flooding potential.
@@ -416,9 +478,9 @@ void rad_project(const t_edpar& edi, rvec* x, t_eigvec* vec)
         rvec_dec(x[i], edi.sav.x[i]);
     }
 
+    projectOntoEigenvectors(edi, x, *vec, vec->refproj);
     for (i = 0; i < vec->neig; i++)
     {
-        vec->refproj[i] = projectx(edi, x, vec->vec[i]);
         rad += gmx::square((vec->refproj[i] - vec->xproj[i]));
     }
     vec->radius = sqrt(rad);
@@ -450,10 +512,7 @@ void project_to_eigvectors(rvec* x, t_eigvec* vec, const t_edpar& edi)
         rvec_dec(x[i], edi.sav.x[i]);
     }
 
-    for (int i = 0; i < vec->neig; i++)
-    {
-        vec->xproj[i] = projectx(edi, x, vec->vec[i]);
-    }
+    projectOntoEigenvectors(edi, x, *vec, vec->xproj);
 
     /* Add average positions */
     for (int i = 0; i < edi.sav.nr; i++)
@@ -2073,9 +2132,8 @@ void do_linacc(rvec* xcoll, t_edpar* edi)
 
 static void do_radfix(rvec* xcoll, t_edpar* edi)
 {
-    int   i, j;
+    int   i;
     real *proj, rad = 0.0, ratio;
-    rvec  vec_dum;
 
 
     if (edi->vecs.radfix.neig == 0)
@@ -2085,11 +2143,10 @@ static void do_radfix(rvec* xcoll, t_edpar* edi)
 
     snew(proj, edi->vecs.radfix.neig);
 
-    /* loop over radfix vectors */
+    /* calculate the projections, radius */
+    projectOntoEigenvectors(*edi, xcoll, edi->vecs.radfix, proj);
     for (i = 0; i < edi->vecs.radfix.neig; i++)
     {
-        /* calculate the projections, radius */
-        proj[i] = projectx(*edi, xcoll, edi->vecs.radfix.vec[i]);
         rad += gmx::square(proj[i] - edi->vecs.radfix.refproj[i]);
     }
 
@@ -2105,12 +2162,8 @@ static void do_radfix(rvec* xcoll, t_edpar* edi)
         /* apply the correction */
         proj[i] /= edi->sav.sqrtm[i];
         proj[i] *= ratio;
-        for (j = 0; j < edi->sav.nr; j++)
-        {
-            svmul(proj[i], edi->vecs.radfix.vec[i][j], vec_dum);
-            rvec_inc(xcoll[j], vec_dum);
-        }
     }
+    addEigenvectorCombination(*edi, edi->vecs.radfix, proj, xcoll);
 
     sfree(proj);
 }
@@ -2118,9 +2171,8 @@ static void do_radfix(rvec* xcoll, t_edpar* edi)
 
 static void do_radacc(rvec* xcoll, t_edpar* edi)
 {
-    int   i, j;
+    int   i;
     real *proj, rad = 0.0, ratio = 0.0;
-    rvec  vec_dum;
 
 
     if (edi->vecs.radacc.neig == 0)
@@ -2130,11 +2182,10 @@ static void do_radacc(rvec* xcoll, t_edpar* edi)
 
     snew(proj, edi->vecs.radacc.neig);
 
-    /* loop over radacc vectors */
+    /* calculate the projections, radius */
+    projectOntoEigenvectors(*edi, xcoll, edi->vecs.radacc, proj);
     for (i = 0; i < edi->vecs.radacc.neig; i++)
     {
-        /* calculate the projections, radius */
-        proj[i] = projectx(*edi, xcoll, edi->vecs.radacc.vec[i]);
         rad += gmx::square(proj[i] - edi->vecs.radacc.refproj[i]);
     }
     rad = sqrt(rad);
@@ -2157,12 +2208,8 @@ static void do_radacc(rvec* xcoll, t_edpar* edi)
         /* apply the correction */
         proj[i] /= edi->sav.sqrtm[i];
         proj[i] *= ratio;
-        for (j = 0; j < edi->sav.nr; j++)
-        {
-            svmul(proj[i], edi->vecs.radacc.vec[i][j], vec_dum);
-            rvec_inc(xcoll[j], vec_dum);
-        }
     }
+    addEigenvectorCombination(*edi, edi->vecs.radacc, proj, xcoll);
     sfree(proj);
 }
 
@@ -2174,11 +2221,10 @@ struct t_do_radcon
 
 static void do_radcon(rvec* xcoll, t_edpar* edi)
 {
-    int                 i, j;
+    int                 i;
     real                rad = 0.0, ratio = 0.0;
     struct t_do_radcon* loc;
     gmx_bool            bFirst;
-    rvec                vec_dum;
 
 
     if (edi->buf->do_radcon != nullptr)
@@ -2202,11 +2248,10 @@ static void do_radcon(rvec* xcoll, t_edpar* edi)
         snew(loc->proj, edi->vecs.radcon.neig);
     }
 
-    /* loop over radcon vectors */
+    /* calculate the projections, radius */
+    projectOntoEigenvectors(*edi, xcoll, edi->vecs.radcon, loc->proj);
     for (i = 0; i < edi->vecs.radcon.neig; i++)
     {
-        /* calculate the projections, radius */
-        loc->proj[i] = projectx(*edi, xcoll, edi->vecs.radcon.vec[i]);
         rad += gmx::square(loc->proj[i] - edi->vecs.radcon.refproj[i]);
     }
     rad = sqrt(rad);
@@ -2222,13 +2267,8 @@ static void do_radcon(rvec* xcoll, t_edpar* edi)
             loc->proj[i] -= edi->vecs.radcon.refproj[i];
             loc->proj[i] /= edi->sav.sqrtm[i];
             loc->proj[i] *= ratio;
-
-            for (j = 0; j < edi->sav.nr; j++)
-            {
-                svmul(loc->proj[i], edi->vecs.radcon.vec[i][j], vec_dum);
-                rvec_inc(xcoll[j], vec_dum);
-            }
         }
+        addEigenvectorCombination(*edi, edi->vecs.radcon, loc->proj, xcoll);
     }
     else
     {
@@ -0,0 +1,139 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2020, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider code modification under the terms of the GNU LGPL, instead
+ * of just copying it with the original copyright, like the GNU GPL.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for trajectory reading with read-ahead
+ *
+ * \ingroup module_fileio
+ */
+#include "gmxpre.h"
+
+#include "gromacs/fileio/trxio.h"
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/fileio/oenv.h"
+#include "gromacs/math/vectypes.h"
+#include "gromacs/trajectory/trajectoryframe.h"
+
+#include "testutils/testfilemanager.h"
+
+namespace
+{
+
+//! Frame contents that are compared between the reading modes.
+struct FrameContents
+{
+    int64_t                step;
+    real                   time;
+    std::vector<gmx::RVec> x;
+};
+
+/*! \brief Reads all frames of \p filename, reading \p readAhead frames ahead.
+ *
+ * Also rewinds once after \p framesBeforeRewind frames, when that is
+ * positive, to check that reading restarts from the beginning. */
+std::vector<FrameContents> readAllFrames(const std::string& filename,
+                                         int                readAhead,
+                                         int                framesBeforeRewind)
+{
+    gmx_output_env_t* oenv;
+    output_env_init_default(&oenv);
+    t_trxstatus*               status;
+    t_trxframe                 fr;
+    std::vector<FrameContents> frames;
+    EXPECT_TRUE(read_first_frame(oenv, &status, filename.c_str(), &fr, TRX_NEED_X));
+    trx_set_read_ahead(status, oenv, &fr, readAhead);
+    do
+    {
+        frames.push_back({ fr.step, fr.time, std::vector<gmx::RVec>(fr.x, fr.x + fr.natoms) });
+        if (framesBeforeRewind > 0 && static_cast<int>(frames.size()) == framesBeforeRewind)
+        {
+            framesBeforeRewind = 0;
+            frames.clear();
+            rewind_trj(status);
+        }
+    } while (read_next_frame(oenv, status, &fr));
+    close_trx(status);
+    done_frame(&fr);
+    output_env_done(oenv);
+    return frames;
+}
+
+class TrxReadAheadTest : public ::testing::TestWithParam<const char*>
+{
+public:
+    gmx::test::TestFileManager fileManager_;
+};
+
+TEST_P(TrxReadAheadTest, ReadsSameFramesAsDirectReading)
+{
+    const std::string filename  = fileManager_.getInputFilePath(GetParam());
+    const auto        reference = readAllFrames(filename, 0, 0);
+    ASSERT_GT(reference.size(), 1U);
+    for (int readAhead : { 1, 3 })
+    {
+        const auto frames = readAllFrames(filename, readAhead, 0);
+        ASSERT_EQ(reference.size(), frames.size());
+        for (size_t i = 0; i < frames.size(); i++)
+        {
+            EXPECT_EQ(reference[i].step, frames[i].step);
+            EXPECT_EQ(reference[i].time, frames[i].time);
+            ASSERT_EQ(reference[i].x.size(), frames[i].x.size());
+            for (size_t a = 0; a < frames[i].x.size(); a++)
+            {
+                for (int d = 0; d < DIM; d++)
+                {
+                    EXPECT_EQ(reference[i].x[a][d], frames[i].x[a][d]);
+                }
+            }
+        }
+    }
+}
+
+TEST_P(TrxReadAheadTest, RestartsAfterRewind)
+{
+    const std::string filename  = fileManager_.getInputFilePath(GetParam());
+    const auto        reference = readAllFrames(filename, 0, 0);
+    const auto        frames    = readAllFrames(filename, 2, 1);
+    ASSERT_EQ(reference.size(), frames.size());
+    EXPECT_EQ(reference[0].step, frames[0].step);
+    EXPECT_EQ(reference.back().step, frames.back().step);
+}
+
+INSTANTIATE_TEST_CASE_P(ForTrajectoryFormats,
+                        TrxReadAheadTest,
+                        ::testing::Values("spc2-traj.trr", "spc2-traj.xtc"));
+
+} // namespace
@@ -3152,10 +3152,6 @@ static void doTpxBodyBuffer(gmx::ISerializer* serializer, gmx::ArrayRef<char> bu
  * The second version is the default for the legacy tools that read the
  * coordinates and velocities separate from the state.
  *
- * After reading in the data, a separate buffer is populated from them
- * containing only \p ir and \p mtop that can be communicated directly
- * to nodes needing the information to set up a simulation.
- *
  * \param[in] tpx The file header.
  * \param[in] serializer The Serialization interface used to read the TPR.
  * \param[out] ir Input rec to populate.
@@ -3164,7 +3160,7 @@ static void doTpxBodyBuffer(gmx::ISerializer* serializer, gmx::ArrayRef<char> bu
  * \param[out] v Velocities to populate if needed.
  * \param[out] mtop Global topology to populate.
  *
- * \returns Partial de-serialized TPR used for communication to nodes.
+ * \returns Partial de-serialized TPR, containing the body as read from file.
  */
 static PartialDeserializedTprFile readTpxBody(TpxFileHeader*    tpx,
                                               gmx::ISerializer* serializer,
@@ -3188,19 +3184,6 @@ static PartialDeserializedTprFile readTpxBody(TpxFileHeader*    tpx,
     {
         partialDeserializedTpr.ePBC = do_tpx_body(serializer, tpx, ir, state, x, v, mtop);
     }
-    // Update header to system info for communication to nodes.
-    // As we only need to communicate the inputrec and mtop to other nodes,
-    // we prepare a new char buffer with the information we have already read
-    // in on master.
-    partialDeserializedTpr.header = populateTpxHeader(*state, ir, mtop);
-    // Long-term we should move to use little endian in files to avoid extra byte swapping,
-    // but since we just used the default XDR format (which is big endian) for the TPR
-    // header it would cause third-party libraries reading our raw data to tear their hair
-    // if we swap the endian in the middle of the file, so we stick to big endian in the
-    // TPR file for now - and thus we ask the serializer to swap if this host is little endian.
-    gmx::InMemorySerializer tprBodySerializer(gmx::EndianSwapBehavior::SwapIfHostIsLittleEndian);
-    do_tpx_body(&tprBodySerializer, &partialDeserializedTpr.header, ir, mtop);
-    partialDeserializedTpr.body = tprBodySerializer.finishAndGetBuffer();
 
     return partialDeserializedTpr;
 }
@@ -3281,6 +3264,23 @@ int completeTprDeserialization(PartialDeserializedTprFile* partialDeserializedTp
     return completeTprDeserialization(partialDeserializedTpr, ir, nullptr, nullptr, nullptr, mtop);
 }
 
+void prepareTpxBodyForCommunication(PartialDeserializedTprFile* partialDeserializedTpr,
+                                    const t_state&              state,
+                                    t_inputrec*                 ir,
+                                    gmx_mtop_t*                 mtop)
+{
+    // Update header to system info for communication to nodes.
+    partialDeserializedTpr->header = populateTpxHeader(state, ir, mtop);
+    // Long-term we should move to use little endian in files to avoid extra byte swapping,
+    // but since we just used the default XDR format (which is big endian) for the TPR
+    // header it would cause third-party libraries reading our raw data to tear their hair
+    // if we swap the endian in the middle of the file, so we stick to big endian in the
+    // TPR file for now - and thus we ask the serializer to swap if this host is little endian.
+    gmx::InMemorySerializer tprBodySerializer(gmx::EndianSwapBehavior::SwapIfHostIsLittleEndian);
+    do_tpx_body(&tprBodySerializer, &partialDeserializedTpr->header, ir, mtop);
+    partialDeserializedTpr->body = tprBodySerializer.finishAndGetBuffer();
+}
+
 PartialDeserializedTprFile read_tpx_state(const char* fn, t_inputrec* ir, t_state* state, gmx_mtop_t* mtop)
 {
     t_fileio* fio;
@@ -165,14 +165,33 @@ int completeTprDeserialization(PartialDeserializedTprFile* partialDeserializedTp
                                t_inputrec*                 ir,
                                gmx_mtop_t*                 mtop);
 
+/*! \brief
+ * Prepares the buffer with the information to be communicated to nodes.
+ *
+ * As we only need to communicate the inputrec and mtop to other nodes,
+ * we prepare a new char buffer with the information we have already read
+ * in on master. This serializes the complete topology again, so it should
+ * only be called when the buffer is actually broadcast.
+ *
+ * \param[in,out] partialDeserializedTpr TPR data as returned by read_tpx_state().
+ * \param[in] state State read from file.
+ * \param[in] ir Input rec read from file.
+ * \param[in] mtop Global topology read from file.
+ */
+void prepareTpxBodyForCommunication(PartialDeserializedTprFile* partialDeserializedTpr,
+                                    const t_state&              state,
+                                    t_inputrec*                 ir,
+                                    gmx_mtop_t*                 mtop);
+
 /*! \brief
  * Read a file to set up a simulation and close it after reading.
  *
  * Main function used to initialize simulations. Reads the input \p fn
  * to populate the \p state, \p ir and \p mtop needed to run a simulations.
  *
- * This function returns the partial deserialized TPR file
- * that can then be communicated to set up non-master nodes to run simulations.
+ * This function returns the partial deserialized TPR file. Before it
+ * can be communicated to set up non-master nodes to run simulations,
+ * it has to be passed to prepareTpxBodyForCommunication().
  *
  * \param[in] fn Input file name.
  * \param[out] ir Input parameters to be set, or nullptr.
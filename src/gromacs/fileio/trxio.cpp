@@ -42,8 +42,15 @@
 
 #include <cassert>
 #include <cmath>
+#include <cstdlib>
 #include <cstring>
 
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 #include "gromacs/fileio/checkpoint.h"
 #include "gromacs/fileio/confio.h"
 #include "gromacs/fileio/filetypes.h"
@@ -79,6 +86,8 @@
 #define SKIP2 100
 #define SKIP3 1000
 
+class TrxReadAhead;
+
 struct t_trxstatus
 {
     int  flags; /* flags for read_first/next_frame  */
@@ -93,6 +102,8 @@ struct t_trxstatus
     double               DT, BOX[3];
     gmx_bool             bReadBox;
     char*                persistent_line; /* Persistent line for reading g96 trajectories */
+    TrxReadAhead*        readAhead;       /* Background reader, NULL when not reading ahead */
+    gmx_bool             bDeferProgress;  /* Progress is printed by the consumer of readAhead */
 #if GMX_USE_PLUGINS
     gmx_vmdplugin_t* vmdplugin;
 #endif
@@ -166,22 +177,331 @@ static void status_init(t_trxstatus* status)
     status->tf              = 0;
     status->persistent_line = nullptr;
     status->tng             = nullptr;
+    status->readAhead       = nullptr;
+    status->bDeferProgress  = FALSE;
+}
+
+static bool read_next_frame_sync(const gmx_output_env_t* oenv, t_trxstatus* status, t_trxframe* fr);
+static void printcount_(int frame, const gmx_output_env_t* oenv, const char* l, real t);
+static void printlast(int frame, const gmx_output_env_t* oenv, real t);
+static void printincomp(int frame, int notOk, real t);
+
+/*! \brief Decodes trajectory frames on a background thread.
+ *
+ * The reader thread runs the normal frame reading loop into a ring of
+ * preallocated frames, staying at most the ring size ahead of the
+ * consumer. The consumer copies frames out of the ring, so the frame
+ * buffers of the caller keep their ownership semantics.
+ *
+ * While the thread is running, it is the only user of the file handles
+ * and counters in the trajectory status. Progress output is printed by
+ * the consumer when frames are handed out, so frame counts and messages
+ * appear in the same order as without read-ahead; skipped frames are
+ * not reported.
+ */
+class TrxReadAhead
+{
+public:
+    TrxReadAhead(t_trxstatus* status, const gmx_output_env_t* oenv, const t_trxframe& fr, int nframes) :
+        status_(status),
+        oenv_(oenv),
+        ring_(nframes)
+    {
+        for (Slot& slot : ring_)
+        {
+            /* Shallow copy to inherit natoms, pbc etc. The atoms are only
+             * read with the first frame, so the slots do not refer to the
+             * atoms of the caller, which the reader thread then could
+             * modify concurrently.
+             */
+            slot.frame        = fr;
+            slot.frame.atoms  = nullptr;
+            slot.frame.bAtoms = FALSE;
+            slot.frame.x      = nullptr;
+            slot.frame.v = nullptr;
+            slot.frame.f = nullptr;
+            if (fr.x != nullptr)
+            {
+                snew(slot.frame.x, fr.natoms);
+            }
+            if (fr.v != nullptr)
+            {
+                snew(slot.frame.v, fr.natoms);
+            }
+            if (fr.f != nullptr)
+            {
+                snew(slot.frame.f, fr.natoms);
+            }
+        }
+        start();
+    }
+    ~TrxReadAhead()
+    {
+        stop();
+        for (Slot& slot : ring_)
+        {
+            sfree(slot.frame.x);
+            sfree(slot.frame.v);
+            sfree(slot.frame.f);
+        }
+    }
+
+    //! Returns the frame counter of the frame last handed out.
+    int framesRead() const { return framesRead_; }
+
+    //! Starts the reader thread on an empty ring.
+    void start()
+    {
+        first_      = 0;
+        filled_     = 0;
+        finished_   = false;
+        stop_       = false;
+        error_      = nullptr;
+        framesRead_ = status_->__frame;
+        lastTime_   = status_->tf;
+        /* The thread is not running yet, so we can set the flag here */
+        status_->bDeferProgress = TRUE;
+        thread_                 = std::thread([this]() { run(); });
+    }
+
+    //! Stops the reader thread and discards all frames read ahead.
+    void stop()
+    {
+        if (!thread_.joinable())
+        {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        slotFree_.notify_one();
+        thread_.join();
+        framesRead_             = status_->__frame;
+        status_->bDeferProgress = FALSE;
+    }
+
+    /*! \brief Copies the next frame into \p fr.
+     *
+     * Blocks until the reader thread has produced a frame or reached the
+     * end of the trajectory. Errors on the reader thread are rethrown here.
+     * Prints the progress output the reader thread deferred.
+     */
+    bool nextFrame(t_trxframe* fr)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        slotFilled_.wait(lock, [this]() { return filled_ > 0 || finished_; });
+        if (filled_ == 0)
+        {
+            if (error_)
+            {
+                std::rethrow_exception(error_);
+            }
+            /* The reader thread has finished, so we can access the status */
+            printlast(status_->__frame, oenv_, lastTime_);
+            if (finalNotOk_)
+            {
+                printincomp(status_->__frame, finalNotOk_, finalTime_);
+            }
+            fr->not_ok = finalNotOk_;
+            return false;
+        }
+        /* The reader thread does not touch filled slots */
+        const Slot& slot = ring_[first_];
+        lock.unlock();
+        copyFrame(slot.frame, fr);
+        framesRead_ = slot.frameCount;
+        lastTime_   = slot.frame.time;
+        printcount_(framesRead_, oenv_, "Reading frame", lastTime_);
+        lock.lock();
+        first_ = (first_ + 1) % ring_.size();
+        filled_--;
+        lock.unlock();
+        slotFree_.notify_one();
+
+        return true;
+    }
+
+private:
+    struct Slot
+    {
+        t_trxframe frame;
+        int        frameCount = -1;
+    };
+
+    void run()
+    {
+        try
+        {
+            while (true)
+            {
+                size_t slot;
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    slotFree_.wait(lock, [this]() { return stop_ || filled_ < ring_.size(); });
+                    if (stop_)
+                    {
+                        return;
+                    }
+                    slot = (first_ + filled_) % ring_.size();
+                }
+                bool bRet = read_next_frame_sync(oenv_, status_, &ring_[slot].frame);
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    if (bRet)
+                    {
+                        ring_[slot].frameCount = status_->__frame;
+                        filled_++;
+                    }
+                    else
+                    {
+                        finalNotOk_ = ring_[slot].frame.not_ok;
+                        finalTime_  = ring_[slot].frame.time;
+                        finished_   = true;
+                    }
+                }
+                slotFilled_.notify_one();
+                if (!bRet)
+                {
+                    return;
+                }
+            }
+        }
+        catch (...)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                error_    = std::current_exception();
+                finished_ = true;
+            }
+            slotFilled_.notify_one();
+        }
+    }
+
+    //! Copies the contents of \p src into the buffers of \p dest.
+    static void copyFrame(const t_trxframe& src, t_trxframe* dest)
+    {
+        dest->not_ok    = src.not_ok;
+        dest->bDouble   = src.bDouble;
+        dest->natoms    = src.natoms;
+        dest->bStep     = src.bStep;
+        dest->step      = src.step;
+        dest->bTime     = src.bTime;
+        dest->time      = src.time;
+        dest->bLambda   = src.bLambda;
+        dest->bFepState = src.bFepState;
+        dest->lambda    = src.lambda;
+        dest->fep_state = src.fep_state;
+        dest->bAtoms    = src.bAtoms;
+        dest->bPrec     = src.bPrec;
+        dest->prec      = src.prec;
+        dest->bBox      = src.bBox;
+        copy_mat(src.box, dest->box);
+        dest->bPBC = src.bPBC;
+        dest->ePBC = src.ePBC;
+        dest->bX   = src.bX;
+        if (src.bX)
+        {
+            if (dest->x == nullptr)
+            {
+                snew(dest->x, src.natoms);
+            }
+            std::memcpy(dest->x, src.x, src.natoms * sizeof(*src.x));
+        }
+        dest->bV = src.bV;
+        if (src.bV)
+        {
+            if (dest->v == nullptr)
+            {
+                snew(dest->v, src.natoms);
+            }
+            std::memcpy(dest->v, src.v, src.natoms * sizeof(*src.v));
+        }
+        dest->bF = src.bF;
+        if (src.bF)
+        {
+            if (dest->f == nullptr)
+            {
+                snew(dest->f, src.natoms);
+            }
+            std::memcpy(dest->f, src.f, src.natoms * sizeof(*src.f));
+        }
+    }
+
+    t_trxstatus*            status_;
+    const gmx_output_env_t* oenv_;
+    std::vector<Slot>       ring_;
+    //! Index of the oldest filled slot.
+    size_t first_ = 0;
+    //! Number of filled slots.
+    size_t filled_ = 0;
+    //! Whether the reader thread reached the end of the trajectory or failed.
+    bool finished_ = false;
+    //! Set by the consumer to stop the reader thread.
+    bool               stop_       = false;
+    int                finalNotOk_ = 0;
+    real               finalTime_  = 0;
+    std::exception_ptr error_;
+    //! Frame counter and time of the frame last handed out, only used by the consumer.
+    int                     framesRead_ = -1;
+    real                    lastTime_   = 0;
+    std::mutex              mutex_;
+    std::condition_variable slotFree_;
+    std::condition_variable slotFilled_;
+    std::thread             thread_;
+};
+
+void trx_set_read_ahead(t_trxstatus* status, const gmx_output_env_t* oenv, const t_trxframe* fr, int nframes)
+{
+    delete status->readAhead;
+    status->readAhead = nullptr;
+    if (nframes > 0 && status->fio != nullptr && gmx_fio_getftp(status->fio) == efCPT)
+    {
+        /* Checkpoint files contain a single frame */
+        return;
+    }
+    if (nframes > 0)
+    {
+        status->readAhead = new TrxReadAhead(status, oenv, *fr, nframes);
+    }
+}
+
+int trx_read_ahead_from_environment()
+{
+    const char* env = getenv("GMX_TRAJECTORY_READ_AHEAD");
+    if (env == nullptr)
+    {
+        return 0;
+    }
+    char* end;
+    long  nframes = std::strtol(env, &end, 10);
+    if (end == env || *end != '\0' || nframes < 0)
+    {
+        gmx_fatal(FARGS,
+                  "Environment variable GMX_TRAJECTORY_READ_AHEAD should be a non-negative "
+                  "number of frames, not '%s'",
+                  env);
+    }
+    return static_cast<int>(nframes);
 }
 
 
 int nframes_read(t_trxstatus* status)
 {
+    if (status->readAhead)
+    {
+        return status->readAhead->framesRead();
+    }
     return status->__frame;
 }
 
-static void printcount_(t_trxstatus* status, const gmx_output_env_t* oenv, const char* l, real t)
+static void printcount_(int frame, const gmx_output_env_t* oenv, const char* l, real t)
 {
-    if ((status->__frame < 2 * SKIP1 || status->__frame % SKIP1 == 0)
-        && (status->__frame < 2 * SKIP2 || status->__frame % SKIP2 == 0)
-        && (status->__frame < 2 * SKIP3 || status->__frame % SKIP3 == 0)
+    if ((frame < 2 * SKIP1 || frame % SKIP1 == 0) && (frame < 2 * SKIP2 || frame % SKIP2 == 0)
+        && (frame < 2 * SKIP3 || frame % SKIP3 == 0)
         && output_env_get_trajectory_io_verbosity(oenv) != 0)
     {
-        fprintf(stderr, "\r%-14s %6d time %8.3f   ", l, status->__frame, output_env_conv_time(oenv, t));
+        fprintf(stderr, "\r%-14s %6d time %8.3f   ", l, frame, output_env_conv_time(oenv, t));
         fflush(stderr);
     }
 }
@@ -189,25 +509,28 @@ static void printcount_(t_trxstatus* status, const gmx_output_env_t* oenv, const
 static void printcount(t_trxstatus* status, const gmx_output_env_t* oenv, real t, gmx_bool bSkip)
 {
     status->__frame++;
-    printcount_(status, oenv, bSkip ? "Skipping frame" : "Reading frame", t);
+    if (!status->bDeferProgress)
+    {
+        printcount_(status->__frame, oenv, bSkip ? "Skipping frame" : "Reading frame", t);
+    }
 }
 
-static void printlast(t_trxstatus* status, const gmx_output_env_t* oenv, real t)
+static void printlast(int frame, const gmx_output_env_t* oenv, real t)
 {
-    printcount_(status, oenv, "Last frame", t);
+    printcount_(frame, oenv, "Last frame", t);
     fprintf(stderr, "\n");
     fflush(stderr);
 }
 
-static void printincomp(t_trxstatus* status, t_trxframe* fr)
+static void printincomp(int frame, int notOk, real t)
 {
-    if (fr->not_ok & HEADER_NOT_OK)
+    if (notOk & HEADER_NOT_OK)
     {
-        fprintf(stderr, "WARNING: Incomplete header: nr %d time %g\n", status->__frame + 1, fr->time);
+        fprintf(stderr, "WARNING: Incomplete header: nr %d time %g\n", frame + 1, t);
     }
-    else if (fr->not_ok)
+    else if (notOk)
     {
-        fprintf(stderr, "WARNING: Incomplete frame: nr %d time %g\n", status->__frame + 1, fr->time);
+        fprintf(stderr, "WARNING: Incomplete frame: nr %d time %g\n", frame + 1, t);
     }
     fflush(stderr);
 }
@@ -597,6 +920,7 @@ void close_trx(t_trxstatus* status)
     {
         return;
     }
+    delete status->readAhead;
     gmx_tng_close(&status->tng);
     if (status->fio)
     {
@@ -710,7 +1034,7 @@ static gmx_bool pdb_next_x(t_trxstatus* status, FILE* fp, t_trxframe* fr)
     free_symtab(symtab);
     sfree(symtab);
     set_trxframe_ePBC(fr, ePBC);
-    if (nframes_read(status) == 0)
+    if (status->__frame == 0)
     {
         fprintf(stderr, " '%s', %d atoms\n", title, fr->natoms);
     }
@@ -741,7 +1065,7 @@ static gmx_bool pdb_next_x(t_trxstatus* status, FILE* fp, t_trxframe* fr)
         if (na != fr->natoms)
         {
             gmx_fatal(FARGS, "Number of atoms in pdb frame %d is %d instead of %d",
-                      nframes_read(status), na, fr->natoms);
+                      status->__frame, na, fr->natoms);
         }
         return TRUE;
     }
@@ -766,6 +1090,15 @@ static int pdb_first_x(t_trxstatus* status, FILE* fp, t_trxframe* fr)
 }
 
 bool read_next_frame(const gmx_output_env_t* oenv, t_trxstatus* status, t_trxframe* fr)
+{
+    if (status->readAhead)
+    {
+        return status->readAhead->nextFrame(fr);
+    }
+    return read_next_frame_sync(oenv, status, fr);
+}
+
+static bool read_next_frame_sync(const gmx_output_env_t* oenv, t_trxstatus* status, t_trxframe* fr)
 {
     real     pt;
     int      ct;
@@ -869,12 +1202,12 @@ bool read_next_frame(const gmx_output_env_t* oenv, t_trxstatus* status, t_trxfra
 
     } while (bRet && (bMissingData || bSkip));
 
-    if (!bRet)
+    if (!bRet && !status->bDeferProgress)
     {
-        printlast(status, oenv, pt);
+        printlast(status->__frame, oenv, pt);
         if (fr->not_ok)
         {
-            printincomp(status, fr);
+            printincomp(status->__frame, fr->not_ok, fr->time);
         }
     }
 
@@ -947,7 +1280,7 @@ bool read_first_frame(const gmx_output_env_t* oenv, t_trxstatus** status, const
             if (fr->not_ok)
             {
                 fr->natoms = 0;
-                printincomp(*status, fr);
+                printincomp((*status)->__frame, fr->not_ok, fr->time);
             }
             else
             {
@@ -966,7 +1299,7 @@ bool read_first_frame(const gmx_output_env_t* oenv, t_trxstatus** status, const
             {
                 fr->not_ok = DATA_NOT_OK;
                 fr->natoms = 0;
-                printincomp(*status, fr);
+                printincomp((*status)->__frame, fr->not_ok, fr->time);
             }
             else
             {
@@ -1074,9 +1407,17 @@ gmx_bool read_next_x(const gmx_output_env_t* oenv, t_trxstatus* status, real* t,
 
 void rewind_trj(t_trxstatus* status)
 {
+    if (status->readAhead)
+    {
+        status->readAhead->stop();
+    }
     initcount(status);
 
     gmx_fio_rewind(status->fio);
+    if (status->readAhead)
+    {
+        status->readAhead->start();
+    }
 }
 
 /***** T O P O L O G Y   S T U F F ******/
@@ -242,6 +242,21 @@ gmx_bool read_next_x(const gmx_output_env_t* oenv, t_trxstatus* status, real* t,
 void rewind_trj(t_trxstatus* status);
 /* Rewind trajectory file as opened with read_first_x */
 
+void trx_set_read_ahead(t_trxstatus* status, const gmx_output_env_t* oenv, const t_trxframe* fr, int nframes);
+/* Enable reading ahead of up to nframes frames on a background thread,
+ * call after read_first_frame with the frame passed to it, which provides
+ * the number of atoms and the fields to preallocate in the read-ahead buffers.
+ * Subsequent calls to read_next_frame copy already decoded frames into fr.
+ * nframes=0 disables read-ahead. oenv should stay valid until close_trx.
+ * While reading ahead, the file handle of status should not be used by
+ * the caller, except through read_next_frame, rewind_trj and close_trx.
+ */
+
+int trx_read_ahead_from_environment();
+/* Returns the number of frames to read ahead set by the environment
+ * variable GMX_TRAJECTORY_READ_AHEAD, 0 when not set.
+ */
+
 struct t_topology* read_top(const char* fn, int* ePBC);
 /* Extract a topology data structure from a topology file.
  * If ePBC!=NULL *ePBC gives the pbc type.
@@ -196,6 +196,75 @@ static int xtc_coord(XDR* xd, int* natoms, rvec* box, rvec* x, real* prec, gmx_b
     return result;
 }
 
+/* Reads or writes the coordinate part of a frame, keeping the
+ * coordinates compressed. The order of items matches xdr3dfcoord.
+ */
+static int xtc_packed_coord(XDR* xd, t_xtc_packed_frame* frame, gmx_bool bRead)
+{
+    int i, j, result;
+
+    result = 1;
+    for (i = 0; ((i < DIM) && result); i++)
+    {
+        for (j = 0; ((j < DIM) && result); j++)
+        {
+            result = XTC_CHECK("box", xdr_r2f(xd, &(frame->box[i][j]), bRead));
+        }
+    }
+    if (!result)
+    {
+        return result;
+    }
+
+    int size = frame->natoms;
+    if (!XTC_CHECK("natoms", xdr_int(xd, &size)) || size != frame->natoms)
+    {
+        return 0;
+    }
+    if (size <= 9)
+    {
+        /* Small frames are stored uncompressed */
+        if (bRead)
+        {
+            frame->data.resize(size * DIM * sizeof(float));
+        }
+        return XTC_CHECK("x", xdr_vector(xd, frame->data.data(), size * DIM, sizeof(float),
+                                         reinterpret_cast<xdrproc_t>(xdr_float)));
+    }
+
+    result = XTC_CHECK("precision", xdr_float(xd, &frame->precision));
+    for (i = 0; ((i < DIM) && result); i++)
+    {
+        result = XTC_CHECK("minint", xdr_int(xd, &frame->minint[i]));
+    }
+    for (i = 0; ((i < DIM) && result); i++)
+    {
+        result = XTC_CHECK("maxint", xdr_int(xd, &frame->maxint[i]));
+    }
+    if (result)
+    {
+        result = XTC_CHECK("smallidx", xdr_int(xd, &frame->smallidx));
+    }
+    int nbytes = frame->data.size();
+    if (result)
+    {
+        result = XTC_CHECK("nbytes", xdr_int(xd, &nbytes));
+    }
+    if (result && bRead)
+    {
+        if (nbytes < 0)
+        {
+            return 0;
+        }
+        frame->data.resize(nbytes);
+    }
+    if (result)
+    {
+        result = XTC_CHECK("x", xdr_opaque(xd, frame->data.data(), nbytes));
+    }
+
+    return result;
+}
 
 int write_xtc(t_fileio* fio, int natoms, int64_t step, real time, const rvec* box, const rvec* x, real prec)
 {
@@ -284,3 +353,52 @@ int read_next_xtc(t_fileio* fio, int natoms, int64_t* step, real* time, matrix b
 
     return static_cast<int>(*bOK);
 }
+
+int read_next_xtc_packed(t_fileio* fio, t_xtc_packed_frame* frame, gmx_bool* bOK)
+{
+    int  magic;
+    XDR* xd;
+
+    *bOK = TRUE;
+    xd   = gmx_fio_getxdr(fio);
+
+    if (!xtc_header(xd, &magic, &frame->natoms, &frame->step, &frame->time, TRUE, bOK))
+    {
+        return 0;
+    }
+
+    check_xtc_magic(magic);
+
+    *bOK = (xtc_packed_coord(xd, frame, TRUE) != 0);
+
+    return static_cast<int>(*bOK);
+}
+
+int write_xtc_packed(t_fileio* fio, const t_xtc_packed_frame* frame)
+{
+    int      magic_number = XTC_MAGIC;
+    XDR*     xd;
+    gmx_bool bDum;
+    int      bOK;
+
+    xd = gmx_fio_getxdr(fio);
+
+    /* The XDR routines take non-const pointers, also when writing */
+    t_xtc_packed_frame* wframe = const_cast<t_xtc_packed_frame*>(frame);
+    int                 natoms = frame->natoms;
+    if (xtc_header(xd, &magic_number, &natoms, &wframe->step, &wframe->time, FALSE, &bDum) == 0)
+    {
+        return 0;
+    }
+
+    bOK = xtc_packed_coord(xd, wframe, FALSE);
+
+    if (bOK)
+    {
+        if (gmx_fio_flush(fio) != 0)
+        {
+            bOK = 0;
+        }
+    }
+    return bOK;
+}
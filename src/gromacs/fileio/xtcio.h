@@ -38,12 +38,33 @@
 #ifndef GMX_FILEIO_XTCIO_H
 #define GMX_FILEIO_XTCIO_H
 
+#include <vector>
+
 #include "gromacs/math/vectypes.h"
 #include "gromacs/utility/basedefinitions.h"
 #include "gromacs/utility/real.h"
 
 struct t_fileio;
 
+/* An XTC frame with the coordinates kept in the compressed form stored
+ * in the file. Writing it produces the same bytes as were read, except
+ * for the step and time in the header, which can be changed.
+ */
+struct t_xtc_packed_frame
+{
+    int     natoms = 0;
+    int64_t step   = 0;
+    real    time   = 0;
+    matrix  box    = { { 0 } };
+    /* Compression parameters, only used when natoms > 9 */
+    float precision = 0;
+    int   minint[DIM] = { 0 };
+    int   maxint[DIM] = { 0 };
+    int   smallidx    = 0;
+    /* Compressed coordinate bytes, or plain floats when natoms <= 9 */
+    std::vector<char> data;
+};
+
 /* All functions return 1 if successful, 0 otherwise
  * bOK tells if a frame is not corrupted
  */
@@ -77,4 +98,10 @@ int read_next_xtc(struct t_fileio* fio, int natoms, int64_t* step, real* time, m
 int write_xtc(struct t_fileio* fio, int natoms, int64_t step, real time, const rvec* box, const rvec* x, real prec);
 /* Write a frame to xtc file */
 
+int read_next_xtc_packed(struct t_fileio* fio, t_xtc_packed_frame* frame, gmx_bool* bOK);
+/* Read the next frame without decompressing the coordinates */
+
+int write_xtc_packed(struct t_fileio* fio, const t_xtc_packed_frame* frame);
+/* Write a frame read with read_next_xtc_packed, without recompressing */
+
 #endif
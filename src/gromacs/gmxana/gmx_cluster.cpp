@@ -41,6 +41,7 @@
 #include <cstring>
 
 #include <algorithm>
+#include <vector>
 
 #include "gromacs/commandline/pargs.h"
 #include "gromacs/commandline/viewit.h"
@@ -62,8 +63,10 @@
 #include "gromacs/topology/topology.h"
 #include "gromacs/utility/arraysize.h"
 #include "gromacs/utility/cstringutil.h"
+#include "gromacs/utility/exceptions.h"
 #include "gromacs/utility/fatalerror.h"
 #include "gromacs/utility/futil.h"
+#include "gromacs/utility/gmxomp.h"
 #include "gromacs/utility/smalloc.h"
 #include "gromacs/utility/stringutil.h"
 
@@ -314,6 +317,308 @@ static real rms_dist(int isize, real** d, real** d_r)
     return std::sqrt(r2);
 }
 
+/*! \brief Computes the RMS deviation or RMS distance deviation between frames.
+ *
+ * Owns the work arrays, so each thread needs its own object.
+ */
+class FramePairRmsd
+{
+public:
+    FramePairRmsd(int isize, rvec** xx, const real* mass, gmx_bool bFit, gmx_bool bRMSdist) :
+        isize_(isize),
+        xx_(xx),
+        mass_(mass),
+        bFit_(bFit),
+        bRMSdist_(bRMSdist)
+    {
+        if (bRMSdist_)
+        {
+            snew(d1_, isize_);
+            snew(d2_, isize_);
+            for (int i = 0; i < isize_; i++)
+            {
+                snew(d1_[i], isize_);
+                snew(d2_[i], isize_);
+            }
+        }
+        else
+        {
+            snew(x1_, isize_);
+        }
+    }
+    ~FramePairRmsd()
+    {
+        if (bRMSdist_)
+        {
+            for (int i = 0; i < isize_; i++)
+            {
+                sfree(d1_[i]);
+                sfree(d2_[i]);
+            }
+            sfree(d1_);
+            sfree(d2_);
+        }
+        sfree(x1_);
+    }
+
+    //! Sets the frame \p i1 that deviation() compares with.
+    void setReference(int i1)
+    {
+        i1_ = i1;
+        if (bRMSdist_)
+        {
+            calc_dist(isize_, xx_[i1_], d1_);
+        }
+    }
+
+    //! Returns the deviation between the reference frame and frame \p i2.
+    real deviation(int i2)
+    {
+        if (bRMSdist_)
+        {
+            calc_dist(isize_, xx_[i2], d2_);
+            return rms_dist(isize_, d1_, d2_);
+        }
+        for (int i = 0; i < isize_; i++)
+        {
+            copy_rvec(xx_[i1_][i], x1_[i]);
+        }
+        if (bFit_)
+        {
+            do_fit(isize_, mass_, xx_[i2], x1_);
+        }
+        return rmsdev(isize_, mass_, xx_[i2], x1_);
+    }
+
+    //! Returns the deviation between frames \p i1 and \p i2.
+    real operator()(int i1, int i2)
+    {
+        setReference(i1);
+        return deviation(i2);
+    }
+
+private:
+    int         isize_;
+    rvec**      xx_;
+    const real* mass_;
+    gmx_bool    bFit_;
+    gmx_bool    bRMSdist_;
+    int         i1_ = -1;
+    rvec*       x1_ = nullptr;
+    real**      d1_ = nullptr;
+    real**      d2_ = nullptr;
+};
+
+//! Prints the number of frame pairs left out of \p nrms, called by one thread at a time.
+static void print_rms_progress(int64_t nrms, int64_t done)
+{
+    fprintf(stderr,
+            "\r# RMSD calculations left: "
+            "%" PRId64 "   ",
+            nrms - done);
+    fflush(stderr);
+}
+
+/*! \brief Fills \p rms with the RMS deviation or RMS distance deviation of all frame pairs.
+ *
+ * The rows of the matrix are distributed dynamically over OpenMP threads,
+ * as the number of pairs per row decreases along the matrix. The matrix
+ * statistics are accumulated afterwards in the order of the serial loop,
+ * so the results do not depend on the number of threads.
+ */
+static void calc_rms_matrix(int nf, int isize, rvec** xx, const real* mass, gmx_bool bFit, gmx_bool bRMSdist, t_mat* rms)
+{
+    const int64_t nrms     = (static_cast<int64_t>(nf) * static_cast<int64_t>(nf - 1)) / 2;
+    int64_t       nrmsDone = 0;
+
+#pragma omp parallel
+    {
+        try
+        {
+            FramePairRmsd pairRmsd(isize, xx, mass, bFit, bRMSdist);
+
+#pragma omp for schedule(dynamic)
+            for (int i1 = 0; i1 < nf; i1++)
+            {
+                pairRmsd.setReference(i1);
+                for (int i2 = i1 + 1; i2 < nf; i2++)
+                {
+                    rms->mat[i1][i2] = pairRmsd.deviation(i2);
+                }
+
+#pragma omp critical(rms_progress)
+                {
+                    nrmsDone += nf - i1 - 1;
+                    print_rms_progress(nrms, nrmsDone);
+                }
+            }
+        }
+        GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
+    }
+
+    for (int i1 = 0; i1 < nf; i1++)
+    {
+        for (int i2 = i1 + 1; i2 < nf; i2++)
+        {
+            set_mat_entry(rms, i1, i2, rms->mat[i1][i2]);
+        }
+    }
+}
+
+/*! \brief Returns the RMS deviations between the \p nstr frames \p structure of one cluster.
+ *
+ * Used when the RMSD matrix is not stored. Each pair is computed once and
+ * the rows are distributed over OpenMP threads as in calc_rms_matrix().
+ * The returned \p nstr x \p nstr matrix is symmetric and stored by row.
+ */
+static std::vector<real> calc_cluster_rms(int         nstr,
+                                          const int*  structure,
+                                          int         isize,
+                                          rvec**      xx,
+                                          const real* mass,
+                                          gmx_bool    bFit,
+                                          gmx_bool    bRMSdist)
+{
+    std::vector<real> rms(static_cast<size_t>(nstr) * nstr, 0);
+    if (nstr < 2)
+    {
+        return rms;
+    }
+
+#pragma omp parallel
+    {
+        try
+        {
+            FramePairRmsd pairRmsd(isize, xx, mass, bFit, bRMSdist);
+
+#pragma omp for schedule(dynamic)
+            for (int i1 = 0; i1 < nstr; i1++)
+            {
+                pairRmsd.setReference(structure[i1]);
+                for (int i2 = i1 + 1; i2 < nstr; i2++)
+                {
+                    const real r        = pairRmsd.deviation(structure[i2]);
+                    rms[i1 * nstr + i2] = r;
+                    rms[i2 * nstr + i1] = r;
+                }
+            }
+        }
+        GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
+    }
+
+    return rms;
+}
+
+/*! \brief Returns the lists of neighbors within \p rmsdcut of all frames, without storing the RMSD matrix.
+ *
+ * Each frame is its own neighbor, as with a matrix in gromos().
+ * The rows are computed in parallel as in calc_rms_matrix(), storing only
+ * the pairs within the cut-off. The minimum, maximum and sum of the RMSD
+ * values over all pairs are returned in \p minrms, \p maxrms and \p sumrms,
+ * accumulated per row and then in row order, so they do not depend on
+ * the number of threads.
+ */
+static t_nnb* calc_rms_neighbors(int         nf,
+                                 int         isize,
+                                 rvec**      xx,
+                                 const real* mass,
+                                 gmx_bool    bFit,
+                                 gmx_bool    bRMSdist,
+                                 real        rmsdcut,
+                                 real*       minrms,
+                                 real*       maxrms,
+                                 real*       sumrms)
+{
+    const int64_t     nrms     = (static_cast<int64_t>(nf) * static_cast<int64_t>(nf - 1)) / 2;
+    int64_t           nrmsDone = 0;
+    std::vector<real> rowMin(nf, 1e20), rowMax(nf, 0), rowSum(nf, 0);
+    /* The neighbors j > i of each row i */
+    t_nnb* upper;
+    snew(upper, nf);
+
+#pragma omp parallel
+    {
+        try
+        {
+            FramePairRmsd pairRmsd(isize, xx, mass, bFit, bRMSdist);
+
+#pragma omp for schedule(dynamic)
+            for (int i1 = 0; i1 < nf; i1++)
+            {
+                int maxval = 0;
+                pairRmsd.setReference(i1);
+                for (int i2 = i1 + 1; i2 < nf; i2++)
+                {
+                    real rmsd = pairRmsd.deviation(i2);
+                    rowMin[i1] = std::min(rowMin[i1], rmsd);
+                    rowMax[i1] = std::max(rowMax[i1], rmsd);
+                    rowSum[i1] += rmsd;
+                    if (rmsd < rmsdcut)
+                    {
+                        if (upper[i1].nr >= maxval)
+                        {
+                            maxval += 10;
+                            srenew(upper[i1].nb, maxval);
+                        }
+                        upper[i1].nb[upper[i1].nr++] = i2;
+                    }
+                }
+
+#pragma omp critical(rms_progress)
+                {
+                    nrmsDone += nf - i1 - 1;
+                    print_rms_progress(nrms, nrmsDone);
+                }
+            }
+        }
+        GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
+    }
+
+    *minrms = 1e20;
+    *maxrms = 0;
+    *sumrms = 0;
+    for (int i = 0; i < nf; i++)
+    {
+        *minrms = std::min(*minrms, rowMin[i]);
+        *maxrms = std::max(*maxrms, rowMax[i]);
+        *sumrms += rowSum[i];
+    }
+
+    /* Make the lists symmetric, the neighbors end up sorted by index */
+    t_nnb* nnb;
+    snew(nnb, nf);
+    for (int i = 0; i < nf; i++)
+    {
+        nnb[i].nr += (rmsdcut > 0 ? 1 : 0) + upper[i].nr;
+        for (int n = 0; n < upper[i].nr; n++)
+        {
+            nnb[upper[i].nb[n]].nr++;
+        }
+    }
+    for (int i = 0; i < nf; i++)
+    {
+        snew(nnb[i].nb, nnb[i].nr);
+        nnb[i].nr = 0;
+    }
+    for (int i = 0; i < nf; i++)
+    {
+        if (rmsdcut > 0)
+        {
+            nnb[i].nb[nnb[i].nr++] = i;
+        }
+        for (int n = 0; n < upper[i].nr; n++)
+        {
+            const int j            = upper[i].nb[n];
+            nnb[i].nb[nnb[i].nr++] = j;
+            nnb[j].nb[nnb[j].nr++] = i;
+        }
+        sfree(upper[i].nb);
+    }
+    sfree(upper);
+
+    return nnb;
+}
+
 static bool rms_dist_comp(const t_dist& a, const t_dist& b)
 {
     return a.dist < b.dist;
@@ -637,20 +942,24 @@ static void dump_nnb(FILE* fp, const char* title, int n1, t_nnb* nnb)
     }
 }
 
-static void gromos(int n1, real** mat, real rmsdcut, t_clusters* clust)
+//! Returns the lists of neighbors within \p rmsdcut from the RMSD matrix \p mat.
+static t_nnb* gromos_neighbors(int n1, real** mat, real rmsdcut)
 {
     t_nnb* nnb;
-    int    i, j, k, j1, maxval;
+    int    nDone = 0;
 
-    /* Put all neighbors nearer than rmsdcut in the list */
+    /* Put all neighbors nearer than rmsdcut in the list,
+     * the rows are independent, so we can build them in parallel.
+     */
     fprintf(stderr, "Making list of neighbors within cutoff ");
     snew(nnb, n1);
-    for (i = 0; (i < n1); i++)
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < n1; i++)
     {
-        maxval = 0;
-        k      = 0;
+        int maxval = 0;
+        int k      = 0;
         /* put all neighbors within cut-off in list */
-        for (j = 0; j < n1; j++)
+        for (int j = 0; j < n1; j++)
         {
             if (mat[i][j] < rmsdcut)
             {
@@ -665,13 +974,28 @@ static void gromos(int n1, real** mat, real rmsdcut, t_clusters* clust)
         }
         /* store nr of neighbors, we'll need that */
         nnb[i].nr = k;
-        if (i % (1 + n1 / 100) == 0)
+#pragma omp critical(gromos_progress)
         {
-            fprintf(stderr, "%3d%%\b\b\b\b", (i * 100 + 1) / n1);
+            nDone++;
+            if (nDone % (1 + n1 / 100) == 0)
+            {
+                fprintf(stderr, "%3d%%\b\b\b\b", (nDone * 100 + 1) / n1);
+            }
         }
     }
     fprintf(stderr, "%3d%%\n", 100);
 
+    return nnb;
+}
+
+/*! \brief Assigns the gromos clusters from the neighbor lists \p nnb of \p n1 frames.
+ *
+ * Takes ownership of \p nnb.
+ */
+static void gromos_clusters(int n1, t_nnb* nnb, t_clusters* clust)
+{
+    int i, j, k, j1;
+
     /* sort neighbor list on number of neighbors, largest first */
     std::sort(nnb, nnb + n1, nrnb_comp);
 
@@ -737,6 +1061,11 @@ static void gromos(int n1, real** mat, real rmsdcut, t_clusters* clust)
     clust->ncl = k - 1;
 }
 
+static void gromos(int n1, real** mat, real rmsdcut, t_clusters* clust)
+{
+    gromos_clusters(n1, gromos_neighbors(n1, mat, rmsdcut), clust);
+}
+
 static rvec** read_whole_trj(const char*             fn,
                              int                     isize,
                              const int               index[],
@@ -971,6 +1300,11 @@ static void ana_trans(t_clusters*             clust,
     sfree(axis);
 }
 
+/*! \brief Analyzes and writes the clusters.
+ *
+ * The RMSD values are taken from \p rmsd, or computed for the pairs
+ * within each cluster when the matrix is not stored.
+ */
 static void analyze_clusters(int                     nf,
                              t_clusters*             clust,
                              real**                  rmsd,
@@ -997,6 +1331,7 @@ static void analyze_clusters(int                     nf,
                              int                     write_nst,
                              real                    rmsmin,
                              gmx_bool                bFit,
+                             gmx_bool                bRMSdist,
                              FILE*                   log,
                              t_rgb                   rlo,
                              t_rgb                   rhi,
@@ -1149,6 +1484,15 @@ static void analyze_clusters(int                     nf,
                 }
             }
         }
+        /* RMSDs between the structures i and j of this cluster */
+        std::vector<real> clusterRmsd;
+        if (!rmsd)
+        {
+            clusterRmsd = calc_cluster_rms(nstr, structure, natom, xx, mass, bFit, bRMSdist);
+        }
+        auto rmsdInCluster = [rmsd, structure, nstr, &clusterRmsd](int i, int j) {
+            return rmsd ? rmsd[structure[i]][structure[j]] : clusterRmsd[i * nstr + j];
+        };
         if (sizefn)
         {
             fprintf(size_fp, "%8d %8d\n", cl, nstr);
@@ -1169,11 +1513,11 @@ static void analyze_clusters(int                     nf,
                 {
                     if (i < i1)
                     {
-                        r += rmsd[structure[i]][structure[i1]];
+                        r += rmsdInCluster(i, i1);
                     }
                     else
                     {
-                        r += rmsd[structure[i1]][structure[i]];
+                        r += rmsdInCluster(i1, i);
                     }
                 }
                 r /= (nstr - 1);
@@ -1259,7 +1603,7 @@ static void analyze_clusters(int                     nf,
                         {
                             if (bWrite[i1])
                             {
-                                bWrite[i] = rmsd[structure[i1]][structure[i]] > rmsmin;
+                                bWrite[i] = rmsdInCluster(i1, i) > rmsmin;
                             }
                         }
                     }
@@ -1381,7 +1725,11 @@ int gmx_cluster(int argc, char* argv[])
         "Count number of neighbors using cut-off, take structure with",
         "largest number of neighbors with all its neighbors as cluster",
         "and eliminate it from the pool of clusters. Repeat for remaining",
-        "structures in pool.[PAR]",
+        "structures in pool.",
+        "With [TT]-nomatrix[tt], the RMSD matrix is not stored, only the",
+        "neighbors within the cut-off of each structure. This reduces the",
+        "memory usage for many frames, but the matrix [TT]-o[tt] and the",
+        "distribution [TT]-dist[tt] are not written.[PAR]",
 
         "When the clustering algorithm assigns each structure to exactly one",
         "cluster (single linkage, Jarvis Patrick and gromos) and a trajectory",
@@ -1424,16 +1772,16 @@ int gmx_cluster(int argc, char* argv[])
         "   of the cluster.",
     };
 
-    FILE *  fp, *log;
-    int     nf   = 0, i, i1, i2, j;
-    int64_t nrms = 0;
+    FILE * fp, *log;
+    int    nf = 0, i, i1, i2, j;
 
     matrix      box;
     matrix*     boxes = nullptr;
-    rvec *      xtps, *usextps, *x1, **xx = nullptr;
+    rvec *      xtps, *usextps, **xx = nullptr;
     const char *fn, *trx_out_fn;
     t_clusters  clust;
     t_mat *     rms, *orig = nullptr;
+    t_nnb*      nnb = nullptr;
     real*       eigenvalues;
     t_topology  top;
     int         ePBC;
@@ -1443,7 +1791,7 @@ int gmx_cluster(int argc, char* argv[])
     int      isize = 0, ifsize = 0, iosize = 0;
     int *    index = nullptr, *fitidx = nullptr, *outidx = nullptr, *frameindices = nullptr;
     char*    grpname;
-    real     rmsd, **d1, **d2, *time = nullptr, time_invfac, *mass = nullptr;
+    real *   time = nullptr, time_invfac, *mass = nullptr;
     char     buf[STRLEN], buf1[80];
     gmx_bool bAnalyze, bUseRmsdCut, bJP_RMSD = FALSE, bReadMat, bReadTraj, bPBC = TRUE;
 
@@ -1468,7 +1816,7 @@ int gmx_cluster(int argc, char* argv[])
     static t_rgb rhi_bot = { 0.0, 0.0, 1.0 };
     static int   nlevels = 40, skip = 1;
     static real  scalemax = -1.0, rmsdcut = 0.1, rmsmin = 0.0;
-    gmx_bool     bRMSdist = FALSE, bBinary = FALSE, bAverage = FALSE, bFit = TRUE;
+    gmx_bool     bRMSdist = FALSE, bBinary = FALSE, bAverage = FALSE, bFit = TRUE, bMatrix = TRUE;
     static int   niter = 10000, nrandom = 0, seed = 0, write_ncl = 0, write_nst = 1, minstruct = 1;
     static real  kT = 1e-3;
     static int   M = 10, P = 3;
@@ -1550,7 +1898,13 @@ int gmx_cluster(int argc, char* argv[])
           { &kT },
           "Boltzmann weighting factor for Monte Carlo optimization "
           "(zero turns off uphill steps)" },
-        { "-pbc", FALSE, etBOOL, { &bPBC }, "PBC check" }
+        { "-pbc", FALSE, etBOOL, { &bPBC }, "PBC check" },
+        { "-matrix",
+          FALSE,
+          etBOOL,
+          { &bMatrix },
+          "Store the RMSD matrix, with [TT]-nomatrix[tt] only gromos clustering of a "
+          "trajectory is supported" }
     };
     t_filenm fnm[] = {
         { efTRX, "-f", nullptr, ffOPTRD },         { efTPS, "-s", nullptr, ffREAD },
@@ -1609,6 +1963,13 @@ int gmx_cluster(int argc, char* argv[])
 
     bAnalyze = (method == m_linkage || method == m_jarvis_patrick || method == m_gromos);
 
+    if (!bMatrix && (method != m_gromos || bReadMat || bBinary))
+    {
+        gmx_fatal(FARGS,
+                  "Option -nomatrix can only be used with -method gromos, "
+                  "without -dm and without -binary");
+    }
+
     /* Open log file */
     log = ftp2FILE(efLOG, NFILE, fnm, "w");
 
@@ -1784,79 +2145,34 @@ int gmx_cluster(int argc, char* argv[])
     }
     else /* !bReadMat */
     {
-        rms  = init_mat(nf, method == m_diagonalize);
-        nrms = (static_cast<int64_t>(nf) * static_cast<int64_t>(nf - 1)) / 2;
+        /* Without matrix, rms only stores the statistics */
+        rms = init_mat(bMatrix ? nf : 0, method == m_diagonalize);
         if (!bRMSdist)
         {
             fprintf(stderr, "Computing %dx%d RMS deviation matrix\n", nf, nf);
-            /* Initialize work array */
-            snew(x1, isize);
-            for (i1 = 0; i1 < nf; i1++)
-            {
-                for (i2 = i1 + 1; i2 < nf; i2++)
-                {
-                    for (i = 0; i < isize; i++)
-                    {
-                        copy_rvec(xx[i1][i], x1[i]);
-                    }
-                    if (bFit)
-                    {
-                        do_fit(isize, mass, xx[i2], x1);
-                    }
-                    rmsd = rmsdev(isize, mass, xx[i2], x1);
-                    set_mat_entry(rms, i1, i2, rmsd);
-                }
-                nrms -= nf - i1 - 1;
-                fprintf(stderr,
-                        "\r# RMSD calculations left: "
-                        "%" PRId64 "   ",
-                        nrms);
-                fflush(stderr);
-            }
-            sfree(x1);
         }
-        else /* bRMSdist */
+        else
         {
             fprintf(stderr, "Computing %dx%d RMS distance deviation matrix\n", nf, nf);
-
-            /* Initiate work arrays */
-            snew(d1, isize);
-            snew(d2, isize);
-            for (i = 0; (i < isize); i++)
-            {
-                snew(d1[i], isize);
-                snew(d2[i], isize);
-            }
-            for (i1 = 0; i1 < nf; i1++)
-            {
-                calc_dist(isize, xx[i1], d1);
-                for (i2 = i1 + 1; (i2 < nf); i2++)
-                {
-                    calc_dist(isize, xx[i2], d2);
-                    set_mat_entry(rms, i1, i2, rms_dist(isize, d1, d2));
-                }
-                nrms -= nf - i1 - 1;
-                fprintf(stderr,
-                        "\r# RMSD calculations left: "
-                        "%" PRId64 "   ",
-                        nrms);
-                fflush(stderr);
-            }
-            /* Clean up work arrays */
-            for (i = 0; (i < isize); i++)
-            {
-                sfree(d1[i]);
-                sfree(d2[i]);
-            }
-            sfree(d1);
-            sfree(d2);
+        }
+        if (bMatrix)
+        {
+            calc_rms_matrix(nf, isize, xx, mass, bFit, bRMSdist, rms);
+        }
+        else
+        {
+            nnb = calc_rms_neighbors(nf, isize, xx, mass, bFit, bRMSdist, rmsdcut, &rms->minrms,
+                                     &rms->maxrms, &rms->sumrms);
         }
         fprintf(stderr, "\n\n");
     }
     ffprintf_gg(stderr, log, buf, "The RMSD ranges from %g to %g nm\n", rms->minrms, rms->maxrms);
     ffprintf_g(stderr, log, buf, "Average RMSD is %g\n", 2 * rms->sumrms / (nf * (nf - 1)));
     ffprintf_d(stderr, log, buf, "Number of structures for matrix %d\n", nf);
-    ffprintf_g(stderr, log, buf, "Energy of the matrix is %g.\n", mat_energy(rms));
+    if (bMatrix)
+    {
+        ffprintf_g(stderr, log, buf, "Energy of the matrix is %g.\n", mat_energy(rms));
+    }
     if (bUseRmsdCut && (rmsdcut < rms->minrms || rmsdcut > rms->maxrms))
     {
         fprintf(stderr,
@@ -1874,7 +2190,10 @@ int gmx_cluster(int argc, char* argv[])
     }
 
     /* Plot the rmsd distribution */
-    rmsd_distribution(opt2fn("-dist", NFILE, fnm), rms, oenv);
+    if (bMatrix)
+    {
+        rmsd_distribution(opt2fn("-dist", NFILE, fnm), rms, oenv);
+    }
 
     if (bBinary)
     {
@@ -1926,7 +2245,16 @@ int gmx_cluster(int argc, char* argv[])
         case m_jarvis_patrick:
             jarvis_patrick(rms->nn, rms->mat, M, P, bJP_RMSD ? rmsdcut : -1, &clust);
             break;
-        case m_gromos: gromos(rms->nn, rms->mat, rmsdcut, &clust); break;
+        case m_gromos:
+            if (bMatrix)
+            {
+                gromos(rms->nn, rms->mat, rmsdcut, &clust);
+            }
+            else
+            {
+                gromos_clusters(nf, nnb, &clust);
+            }
+            break;
         default: gmx_fatal(FARGS, "DEATH HORROR unknown method \"%s\"", methodname[0]);
     }
 
@@ -1937,11 +2265,11 @@ int gmx_cluster(int argc, char* argv[])
 
     if (bAnalyze)
     {
-        if (minstruct > 1)
+        if (bMatrix && minstruct > 1)
         {
             ncluster = plot_clusters(nf, rms->mat, &clust, minstruct);
         }
-        else
+        else if (bMatrix)
         {
             mark_clusters(nf, rms->mat, rms->maxrms, &clust);
         }
@@ -1956,12 +2284,14 @@ int gmx_cluster(int argc, char* argv[])
             copy_rvec(xtps[index[i]], usextps[i]);
         }
         useatoms.nr = isize;
-        analyze_clusters(nf, &clust, rms->mat, isize, &useatoms, usextps, mass, xx, time, boxes,
+        analyze_clusters(nf, &clust, bMatrix ? rms->mat : nullptr, isize, &useatoms,
+                         usextps, mass, xx, time, boxes,
                          frameindices, ifsize, fitidx, iosize, outidx,
                          bReadTraj ? trx_out_fn : nullptr, opt2fn_null("-sz", NFILE, fnm),
                          opt2fn_null("-tr", NFILE, fnm), opt2fn_null("-ntr", NFILE, fnm),
                          opt2fn_null("-clid", NFILE, fnm), opt2fn_null("-clndx", NFILE, fnm),
-                         bAverage, write_ncl, write_nst, rmsmin, bFit, log, rlo_bot, rhi_bot, oenv);
+                         bAverage, write_ncl, write_nst, rmsmin, bFit, bRMSdist, log, rlo_bot,
+                         rhi_bot, oenv);
         sfree(boxes);
         sfree(frameindices);
     }
@@ -1982,32 +2312,35 @@ int gmx_cluster(int argc, char* argv[])
         }
     }
 
-    fp = opt2FILE("-o", NFILE, fnm, "w");
-    fprintf(stderr, "Writing rms distance/clustering matrix ");
-    if (bReadMat)
-    {
-        write_xpm(fp, 0, readmat[0].title, readmat[0].legend, readmat[0].label_x,
-                  readmat[0].label_y, nf, nf, readmat[0].axis_x.data(), readmat[0].axis_y.data(),
-                  rms->mat, 0.0, rms->maxrms, rlo_top, rhi_top, &nlevels);
-    }
-    else
+    if (bMatrix)
     {
-        auto timeLabel = output_env_get_time_label(oenv);
-        auto title = gmx::formatString("RMS%sDeviation / Cluster Index", bRMSdist ? " Distance " : " ");
-        if (minstruct > 1)
+        fp = opt2FILE("-o", NFILE, fnm, "w");
+        fprintf(stderr, "Writing rms distance/clustering matrix ");
+        if (bReadMat)
         {
-            write_xpm_split(fp, 0, title, "RMSD (nm)", timeLabel, timeLabel, nf, nf, time, time,
-                            rms->mat, 0.0, rms->maxrms, &nlevels, rlo_top, rhi_top, 0.0, ncluster,
-                            &ncluster, TRUE, rlo_bot, rhi_bot);
+            write_xpm(fp, 0, readmat[0].title, readmat[0].legend, readmat[0].label_x,
+                      readmat[0].label_y, nf, nf, readmat[0].axis_x.data(), readmat[0].axis_y.data(),
+                      rms->mat, 0.0, rms->maxrms, rlo_top, rhi_top, &nlevels);
         }
         else
         {
-            write_xpm(fp, 0, title, "RMSD (nm)", timeLabel, timeLabel, nf, nf, time, time, rms->mat,
-                      0.0, rms->maxrms, rlo_top, rhi_top, &nlevels);
+            auto timeLabel = output_env_get_time_label(oenv);
+            auto title = gmx::formatString("RMS%sDeviation / Cluster Index", bRMSdist ? " Distance " : " ");
+            if (minstruct > 1)
+            {
+                write_xpm_split(fp, 0, title, "RMSD (nm)", timeLabel, timeLabel, nf, nf, time, time,
+                                rms->mat, 0.0, rms->maxrms, &nlevels, rlo_top, rhi_top, 0.0, ncluster,
+                                &ncluster, TRUE, rlo_bot, rhi_bot);
+            }
+            else
+            {
+                write_xpm(fp, 0, title, "RMSD (nm)", timeLabel, timeLabel, nf, nf, time, time, rms->mat,
+                          0.0, rms->maxrms, rlo_top, rhi_top, &nlevels);
+            }
         }
+        fprintf(stderr, "\n");
+        gmx_ffclose(fp);
     }
-    fprintf(stderr, "\n");
-    gmx_ffclose(fp);
     if (nullptr != orig)
     {
         fp             = opt2FILE("-om", NFILE, fnm, "w");
@@ -2020,13 +2353,19 @@ int gmx_cluster(int argc, char* argv[])
         sfree(orig);
     }
     /* now show what we've done */
-    do_view(oenv, opt2fn("-o", NFILE, fnm), "-nxy");
+    if (bMatrix)
+    {
+        do_view(oenv, opt2fn("-o", NFILE, fnm), "-nxy");
+    }
     do_view(oenv, opt2fn_null("-sz", NFILE, fnm), "-nxy");
     if (method == m_diagonalize)
     {
         do_view(oenv, opt2fn_null("-ev", NFILE, fnm), "-nxy");
     }
-    do_view(oenv, opt2fn("-dist", NFILE, fnm), "-nxy");
+    if (bMatrix)
+    {
+        do_view(oenv, opt2fn("-dist", NFILE, fnm), "-nxy");
+    }
     if (bAnalyze)
     {
         do_view(oenv, opt2fn_null("-tr", NFILE, fnm), "-nxy");
@@ -94,7 +94,10 @@ int gmx_covar(int argc, char* argv[])
         "of atoms involved. It is easy to run out of memory, in which",
         "case this tool will probably exit with a 'Segmentation fault'. You",
         "should consider carefully whether a reduced set of atoms will meet",
-        "your needs for lower costs."
+        "your needs for lower costs.",
+        "When [TT]-last[tt] is set, only the requested eigenvectors are",
+        "determined, which is considerably faster than a full diagonalization",
+        "when only a few principal components are needed."
     };
     static gmx_bool bFit = TRUE, bRef = FALSE, bM = FALSE, bPBC = TRUE;
     static int      end  = -1;
@@ -130,7 +133,7 @@ int gmx_covar(int argc, char* argv[])
     char              str[STRLEN], *fitname, *ananame;
     int               d, dj, nfit;
     int *             index, *ifit;
-    gmx_bool          bDiffMass1, bDiffMass2;
+    gmx_bool          bDiffMass1, bDiffMass2, bPartial;
     t_rgb             rlo, rmi, rhi;
     real*             eigenvectors;
     gmx_output_env_t* oenv;
@@ -330,6 +333,10 @@ int gmx_covar(int argc, char* argv[])
             }
         }
 
+        /* Each thread owns complete rows of the upper triangle, so no reduction
+         * is needed. The row length decreases with j, hence dynamic scheduling.
+         */
+#pragma omp parallel for schedule(dynamic, 8) private(i, dj, k, l, d, xj) if (natoms >= 100)
         for (j = 0; j < natoms; j++)
         {
             for (dj = 0; dj < DIM; dj++)
@@ -519,23 +526,53 @@ int gmx_covar(int argc, char* argv[])
     snew(eigenvectors, ndim * ndim);
 
     std::memcpy(eigenvectors, mat, ndim * ndim * sizeof(real));
-    fprintf(stderr, "\nDiagonalizing ...\n");
-    fflush(stderr);
-    eigensolver(eigenvectors, ndim, 0, ndim, eigenvalues, mat);
+    /* When only the first eigenvectors are requested, let LAPACK compute
+     * just those, which is much cheaper than a full diagonalization.
+     */
+    bPartial = (end > 0 && end < ndim);
+    if (bPartial)
+    {
+        fprintf(stderr, "\nDiagonalizing, determining the %d largest eigenvalues ...\n", end);
+        fflush(stderr);
+        eigensolver(eigenvectors, ndim, ndim - end, ndim, eigenvalues, mat);
+        /* The solver returns the eigenpairs at the start of the arrays,
+         * move them to the end so the indexing matches a full diagonalization.
+         */
+        for (i = end - 1; i >= 0; i--)
+        {
+            std::memmove(mat + (ndim - end + i) * ndim, mat + i * ndim, ndim * sizeof(real));
+            eigenvalues[ndim - end + i] = eigenvalues[i];
+        }
+    }
+    else
+    {
+        fprintf(stderr, "\nDiagonalizing ...\n");
+        fflush(stderr);
+        eigensolver(eigenvectors, ndim, 0, ndim, eigenvalues, mat);
+    }
     sfree(eigenvectors);
 
     /* now write the output */
 
     sum = 0;
-    for (i = 0; i < ndim; i++)
+    for (i = bPartial ? ndim - end : 0; i < ndim; i++)
     {
         sum += eigenvalues[i];
     }
-    fprintf(stderr, "\nSum of the eigenvalues: %g (%snm^2)\n", sum, bM ? "u " : "");
-    if (std::abs(trace - sum) > 0.01 * trace)
+    if (bPartial)
+    {
+        fprintf(stderr, "\nSum of the %d largest eigenvalues: %g (%snm^2)\n", end, sum,
+                bM ? "u " : "");
+    }
+    else
     {
-        fprintf(stderr,
-                "\nWARNING: eigenvalue sum deviates from the trace of the covariance matrix\n");
+        fprintf(stderr, "\nSum of the eigenvalues: %g (%snm^2)\n", sum, bM ? "u " : "");
+        if (std::abs(trace - sum) > 0.01 * trace)
+        {
+            fprintf(stderr,
+                    "\nWARNING: eigenvalue sum deviates from the trace of the covariance "
+                    "matrix\n");
+        }
     }
 
     /* Set 'end', the maximum eigenvector and -value index used for output */
@@ -629,7 +666,14 @@ int gmx_covar(int argc, char* argv[])
     fprintf(out, "Diagonalized the %dx%d covariance matrix\n", static_cast<int>(ndim),
             static_cast<int>(ndim));
     fprintf(out, "Trace of the covariance matrix before diagonalizing: %g\n", trace);
-    fprintf(out, "Trace of the covariance matrix after diagonalizing: %g\n\n", sum);
+    if (bPartial)
+    {
+        fprintf(out, "Sum of the %d largest eigenvalues: %g\n\n", end, sum);
+    }
+    else
+    {
+        fprintf(out, "Trace of the covariance matrix after diagonalizing: %g\n\n", sum);
+    }
 
     fprintf(out, "Wrote %d eigenvalues to %s\n", static_cast<int>(end), eigvalfile);
     if (WriteXref == eWXR_YES)
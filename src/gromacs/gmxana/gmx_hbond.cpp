@@ -43,7 +43,9 @@
 #include <cstring>
 
 #include <algorithm>
+#include <mutex>
 #include <numeric>
+#include <vector>
 
 #include "gromacs/commandline/pargs.h"
 #include "gromacs/commandline/viewit.h"
@@ -197,6 +199,11 @@ typedef struct
     /* This holds a matrix with all possible hydrogen bonds */
     int        nrhb, nrdist;
     t_hbond*** hbmap;
+
+    /* One lock per donor, protecting hbmap[donor] during the parallel search,
+     * owned by gmx_hbond() as this struct is allocated with snew.
+     */
+    std::mutex* hbmapLock;
 } t_hbdata;
 
 /* Changed argument 'bMerge' into 'oneHB' below,
@@ -322,12 +329,21 @@ static void add_ff(t_hbdata* hbd, int id, int h, int ia, int frame, int ihb)
     else
     {
         hb->nframes = frame - hb->n0;
-        /* We need a while loop here because hbonds may be returning
-         * after a long time.
+        /* Grow the bitmaps geometrically, so that the total cost of
+         * reallocation stays linear in the number of frames. Hbonds may be
+         * returning after a long time, so we may need more than one step.
+         * We never allocate beyond the frames allocated for the whole
+         * trajectory so far, which bounds the over-allocation.
          */
-        while (hb->nframes >= hb->maxframes)
+        if (hb->nframes >= hb->maxframes)
         {
-            n = hb->maxframes + delta;
+            n = hb->maxframes;
+            while (hb->nframes >= n)
+            {
+                n += std::max(delta, n / 2 / delta * delta);
+            }
+            const int maxFrames = std::max(hbd->max_frames, frame + 1) - hb->n0;
+            n                   = std::min(n, (maxFrames + delta - 1) / delta * delta);
             for (i = 0; (i < maxhydro); i++)
             {
                 srenew(hb->h[i], n / wlen);
@@ -506,23 +522,21 @@ add_hbond(t_hbdata* hb, int d, int a, int h, int grpd, int grpa, int frame, gmx_
             k = 0;
         }
 
+        /* Different hydrogens of the same donor can be found by different
+         * threads, so we lock the entries of this donor. Threads working
+         * on other donors can proceed concurrently.
+         */
+        std::unique_lock<std::mutex> donorLock;
         if (hb->bHBmap)
         {
-
-#pragma omp critical
+            donorLock = std::unique_lock<std::mutex>(hb->hbmapLock[id]);
+            if (hb->hbmap[id][ia] == nullptr)
             {
-                try
-                {
-                    if (hb->hbmap[id][ia] == nullptr)
-                    {
-                        snew(hb->hbmap[id][ia], 1);
-                        snew(hb->hbmap[id][ia]->h, hb->maxhydro);
-                        snew(hb->hbmap[id][ia]->g, hb->maxhydro);
-                    }
-                    add_ff(hb, id, k, ia, frame, ihb);
-                }
-                GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR
+                snew(hb->hbmap[id][ia], 1);
+                snew(hb->hbmap[id][ia]->h, hb->maxhydro);
+                snew(hb->hbmap[id][ia]->g, hb->maxhydro);
             }
+            add_ff(hb, id, k, ia, frame, ihb);
         }
 
         /* Strange construction with frame >=0 is a relic from old code
@@ -2785,11 +2799,14 @@ int gmx_hbond(int argc, char* argv[])
 
     donor_properties = open_donor_properties_file(opt2fn_null("-don", NFILE, fnm), hb, oenv);
 
+    std::vector<std::mutex> hbmapLocks;
     if (bHBmap)
     {
         printf("Making hbmap structure...");
         /* Generate hbond data structure */
         mk_hbmap(hb);
+        hbmapLocks    = std::vector<std::mutex>(hb->d.nrd);
+        hb->hbmapLock = hbmapLocks.data();
         printf("done.\n");
     }
 
@@ -2900,16 +2917,17 @@ int gmx_hbond(int argc, char* argv[])
             p_hb[i]->time       = nullptr;
             p_hb[i]->nhx        = nullptr;
 
-            p_hb[i]->bHBmap   = hb->bHBmap;
-            p_hb[i]->bDAnr    = hb->bDAnr;
-            p_hb[i]->wordlen  = hb->wordlen;
-            p_hb[i]->nframes  = hb->nframes;
-            p_hb[i]->maxhydro = hb->maxhydro;
-            p_hb[i]->danr     = hb->danr;
-            p_hb[i]->d        = hb->d;
-            p_hb[i]->a        = hb->a;
-            p_hb[i]->hbmap    = hb->hbmap;
-            p_hb[i]->time     = hb->time; /* This may need re-syncing at every frame. */
+            p_hb[i]->bHBmap    = hb->bHBmap;
+            p_hb[i]->bDAnr     = hb->bDAnr;
+            p_hb[i]->wordlen   = hb->wordlen;
+            p_hb[i]->nframes   = hb->nframes;
+            p_hb[i]->maxhydro  = hb->maxhydro;
+            p_hb[i]->danr      = hb->danr;
+            p_hb[i]->d         = hb->d;
+            p_hb[i]->a         = hb->a;
+            p_hb[i]->hbmap     = hb->hbmap;
+            p_hb[i]->hbmapLock = hb->hbmapLock;
+            p_hb[i]->time      = hb->time; /* This may need re-syncing at every frame. */
 
             p_hb[i]->nrhb   = 0;
             p_hb[i]->nrdist = 0;
@@ -2966,7 +2984,8 @@ int gmx_hbond(int argc, char* argv[])
 
             if (bOMP)
             {
-                p_hb[threadNr]->time = hb->time; /* This pointer may have changed. */
+                p_hb[threadNr]->time       = hb->time; /* This pointer may have changed. */
+                p_hb[threadNr]->max_frames = hb->max_frames;
             }
 
             if (bSelected)
@@ -3243,6 +3262,7 @@ int gmx_hbond(int argc, char* argv[])
     }
 
     free_grid(ngrid, &grid);
+    hb->hbmapLock = nullptr;
 
     close_trx(status);
 
@@ -202,6 +202,14 @@ typedef struct
 
     /*! \brief TRUE, if any data point of the histogram is within min and max, otherwise FALSE */
     gmx_bool** bContrib;
+    /*! \brief Boltzmann factor exp(-U/kT) of the umbrella potential in each bin
+     *
+     * The umbrella potentials do not change during the WHAM iterations, so these
+     * are computed in setup_boltzmann_factors() instead of in every iteration.
+     */
+    double** boltzFactor;
+    //! The exponent -U/kT of boltzFactor, used when the Boltzmann factor underflows
+    double** boltzExponent;
     real**     ztime; //!< input data z(t) as a function of time. Required to compute ACTs
 
     /*! \brief average force estimated from average displacement, fAv=dzAv*k
@@ -349,6 +357,8 @@ static t_UmbrellaWindow* initUmbrellaWindows(int nwin)
         win[i].N = win[i].Ntot = nullptr;
         win[i].g = win[i].tau = win[i].tausmooth = nullptr;
         win[i].bContrib                          = nullptr;
+        win[i].boltzFactor                       = nullptr;
+        win[i].boltzExponent                     = nullptr;
         win[i].ztime                             = nullptr;
         win[i].forceAv                           = nullptr;
         win[i].aver = win[i].sigma = nullptr;
@@ -384,6 +394,14 @@ static void freeUmbrellaWindows(t_UmbrellaWindow* win, int nwin)
                 sfree(win[i].bContrib[j]);
             }
         }
+        if (win[i].boltzFactor)
+        {
+            for (j = 0; j < win[i].nPull; j++)
+            {
+                sfree(win[i].boltzFactor[j]);
+                sfree(win[i].boltzExponent[j]);
+            }
+        }
         sfree(win[i].Histo);
         sfree(win[i].cum);
         sfree(win[i].k);
@@ -395,6 +413,8 @@ static void freeUmbrellaWindows(t_UmbrellaWindow* win, int nwin)
         sfree(win[i].tau);
         sfree(win[i].tausmooth);
         sfree(win[i].bContrib);
+        sfree(win[i].boltzFactor);
+        sfree(win[i].boltzExponent);
         sfree(win[i].ztime);
         sfree(win[i].forceAv);
         sfree(win[i].aver);
@@ -849,6 +869,89 @@ static double tabulated_pot(double dist, t_UmbrellaOptions* opt)
 }
 
 
+//! Return the umbrella potential of pull coordinate \p j of \p window in bin \p k
+static double umbrella_pot(const t_UmbrellaWindow* window, int j, int k, t_UmbrellaOptions* opt)
+{
+    double U, temp, distance, ztot, ztot_half;
+
+    ztot      = opt->max - opt->min;
+    ztot_half = ztot / 2;
+
+    temp     = (1.0 * k + 0.5) * opt->dz + opt->min;
+    distance = temp - window->pos[j]; /* distance to umbrella center */
+    if (opt->bCycl)
+    {                             /* in cyclic wham:             */
+        if (distance > ztot_half) /*    |distance| < ztot_half   */
+        {
+            distance -= ztot;
+        }
+        else if (distance < -ztot_half)
+        {
+            distance += ztot;
+        }
+    }
+
+    if (!opt->bTab)
+    {
+        U = 0.5 * window->k[j] * gmx::square(distance); /* harmonic potential assumed. */
+    }
+    else
+    {
+        U = tabulated_pot(distance, opt); /* Use tabulated potential     */
+    }
+    return U;
+}
+
+/*! \brief
+ * Compute the Boltzmann factors of the umbrella potentials in all bins
+ *
+ * These do not change during the WHAM iterations, so they are computed once
+ * before the iterations instead of evaluating the exponentials in every iteration.
+ */
+static void setup_boltzmann_factors(t_UmbrellaWindow* window, int nWindows, t_UmbrellaOptions* opt)
+{
+    int i, j, k;
+
+    for (i = 0; i < nWindows; ++i)
+    {
+        if (!window[i].boltzFactor)
+        {
+            snew(window[i].boltzFactor, window[i].nPull);
+            snew(window[i].boltzExponent, window[i].nPull);
+        }
+        for (j = 0; j < window[i].nPull; ++j)
+        {
+            if (!window[i].boltzFactor[j])
+            {
+                snew(window[i].boltzFactor[j], opt->bins);
+                snew(window[i].boltzExponent[j], opt->bins);
+            }
+            for (k = 0; k < opt->bins; ++k)
+            {
+                window[i].boltzExponent[j][k] =
+                        -umbrella_pot(&window[i], j, k, opt) / (BOLTZ * opt->Temperature);
+                window[i].boltzFactor[j][k] = std::exp(window[i].boltzExponent[j][k]);
+            }
+        }
+    }
+}
+
+/*! \brief Return N*exp(-U/kT + z) for pull coordinate \p j of \p window in bin \p k
+ *
+ * \p weight should be N*exp(z). When that overflows, which happens for windows
+ * far outside the histogram range, or when exp(-U/kT) underflows while the
+ * weight is large, the exponent is evaluated as a whole.
+ */
+static double weighted_boltzmann_factor(const t_UmbrellaWindow* window, int j, int k, double weight)
+{
+    const double boltzFactor = window->boltzFactor[j][k];
+    if (std::isfinite(weight) && (boltzFactor > 0 || weight <= 1))
+    {
+        return weight * boltzFactor;
+    }
+    return window->N[j] * std::exp(window->boltzExponent[j][k] + window->z[j]);
+}
+
 /*! \brief
  * Check which bins substiantially contribute (accelerates WHAM)
  *
@@ -859,7 +962,7 @@ static double tabulated_pot(double dist, t_UmbrellaOptions* opt)
 static void setup_acc_wham(const double* profile, t_UmbrellaWindow* window, int nWindows, t_UmbrellaOptions* opt)
 {
     int        i, j, k, nGrptot = 0, nContrib = 0, nTot = 0;
-    double     U, min = opt->min, dz = opt->dz, temp, ztot_half, distance, ztot, contrib1, contrib2;
+    double     contrib1, contrib2, weight;
     gmx_bool   bAnyContrib;
     static int bFirst = 1;
     static double wham_contrib_lim;
@@ -873,9 +976,6 @@ static void setup_acc_wham(const double* profile, t_UmbrellaWindow* window, int
         wham_contrib_lim = opt->Tolerance / nGrptot;
     }
 
-    ztot      = opt->max - opt->min;
-    ztot_half = ztot / 2;
-
     for (i = 0; i < nWindows; ++i)
     {
         if (!window[i].bContrib)
@@ -889,38 +989,17 @@ static void setup_acc_wham(const double* profile, t_UmbrellaWindow* window, int
                 snew(window[i].bContrib[j], opt->bins);
             }
             bAnyContrib = FALSE;
+            weight      = window[i].N[j] * std::exp(window[i].z[j]);
             for (k = 0; k < opt->bins; ++k)
             {
-                temp     = (1.0 * k + 0.5) * dz + min;
-                distance = temp - window[i].pos[j]; /* distance to umbrella center */
-                if (opt->bCycl)
-                {                             /* in cyclic wham:             */
-                    if (distance > ztot_half) /*    |distance| < ztot_half   */
-                    {
-                        distance -= ztot;
-                    }
-                    else if (distance < -ztot_half)
-                    {
-                        distance += ztot;
-                    }
-                }
                 /* Note: there are two contributions to bin k in the wham equations:
                    i)  N[j]*exp(- U/(BOLTZ*opt->Temperature) + window[i].z[j])
                    ii) exp(- U/(BOLTZ*opt->Temperature))
                    where U is the umbrella potential
                    If any of these number is larger wham_contrib_lim, I set contrib=TRUE
                  */
-
-                if (!opt->bTab)
-                {
-                    U = 0.5 * window[i].k[j] * gmx::square(distance); /* harmonic potential assumed. */
-                }
-                else
-                {
-                    U = tabulated_pot(distance, opt); /* Use tabulated potential     */
-                }
-                contrib1 = profile[k] * std::exp(-U / (BOLTZ * opt->Temperature));
-                contrib2 = window[i].N[j] * std::exp(-U / (BOLTZ * opt->Temperature) + window[i].z[j]);
+                contrib1                 = profile[k] * window[i].boltzFactor[j][k];
+                contrib2                 = weighted_boltzmann_factor(&window[i], j, k, weight);
                 window[i].bContrib[j][k] = (contrib1 > wham_contrib_lim || contrib2 > wham_contrib_lim);
                 bAnyContrib              = bAnyContrib || window[i].bContrib[j][k];
                 if (window[i].bContrib[j][k])
@@ -958,10 +1037,17 @@ static void setup_acc_wham(const double* profile, t_UmbrellaWindow* window, int
 //! Compute the PMF (one of the two main WHAM routines)
 static void calc_profile(double* profile, t_UmbrellaWindow* window, int nWindows, t_UmbrellaOptions* opt, gmx_bool bExact)
 {
-    double ztot_half, ztot, min = opt->min, dz = opt->dz;
+    std::vector<double> invg, weight;
 
-    ztot      = opt->max - opt->min;
-    ztot_half = ztot / 2;
+    /* The factors that do not depend on the bin are computed only once */
+    for (int j = 0; j < nWindows; ++j)
+    {
+        for (int k = 0; k < window[j].nPull; ++k)
+        {
+            invg.push_back(1.0 / window[j].g[k] * window[j].bsWeight[k]);
+            weight.push_back(window[j].N[k] * std::exp(window[j].z[k]));
+        }
+    }
 
 #pragma omp parallel
     {
@@ -975,44 +1061,20 @@ static void calc_profile(double* profile, t_UmbrellaWindow* window, int nWindows
 
             for (i = i0; i < i1; ++i)
             {
-                int    j, k;
-                double num, denom, invg, temp = 0, distance, U = 0;
+                int    j, k, l = 0;
+                double num, denom;
                 num = denom = 0.;
                 for (j = 0; j < nWindows; ++j)
                 {
-                    for (k = 0; k < window[j].nPull; ++k)
+                    for (k = 0; k < window[j].nPull; ++k, ++l)
                     {
-                        invg = 1.0 / window[j].g[k] * window[j].bsWeight[k];
-                        temp = (1.0 * i + 0.5) * dz + min;
-                        num += invg * window[j].Histo[k][i];
+                        num += invg[l] * window[j].Histo[k][i];
 
                         if (!(bExact || window[j].bContrib[k][i]))
                         {
                             continue;
                         }
-                        distance = temp - window[j].pos[k]; /* distance to umbrella center */
-                        if (opt->bCycl)
-                        {                             /* in cyclic wham:             */
-                            if (distance > ztot_half) /*    |distance| < ztot_half   */
-                            {
-                                distance -= ztot;
-                            }
-                            else if (distance < -ztot_half)
-                            {
-                                distance += ztot;
-                            }
-                        }
-
-                        if (!opt->bTab)
-                        {
-                            U = 0.5 * window[j].k[k] * gmx::square(distance); /* harmonic potential assumed. */
-                        }
-                        else
-                        {
-                            U = tabulated_pot(distance, opt); /* Use tabulated potential     */
-                        }
-                        denom += invg * window[j].N[k]
-                                 * std::exp(-U / (BOLTZ * opt->Temperature) + window[j].z[k]);
+                        denom += invg[l] * weighted_boltzmann_factor(&window[j], k, i, weight[l]);
                     }
                 }
                 profile[i] = num / denom;
@@ -1023,14 +1085,10 @@ static void calc_profile(double* profile, t_UmbrellaWindow* window, int nWindows
 }
 
 //! Compute the free energy offsets z (one of the two main WHAM routines)
-static double calc_z(const double* profile, t_UmbrellaWindow* window, int nWindows, t_UmbrellaOptions* opt, gmx_bool bExact)
+static double calc_z(const double* profile, t_UmbrellaWindow* window, int nWindows, gmx_bool bExact)
 {
-    double min = opt->min, dz = opt->dz, ztot_half, ztot;
     double maxglob = -1e20;
 
-    ztot      = opt->max - opt->min;
-    ztot_half = ztot / 2;
-
 #pragma omp parallel
     {
         try
@@ -1044,7 +1102,7 @@ static double calc_z(const double* profile, t_UmbrellaWindow* window, int nWindo
 
             for (i = i0; i < i1; ++i)
             {
-                double total = 0, temp, distance, U = 0;
+                double total = 0, temp;
                 int    j, k;
 
                 for (j = 0; j < window[i].nPull; ++j)
@@ -1056,29 +1114,7 @@ static double calc_z(const double* profile, t_UmbrellaWindow* window, int nWindo
                         {
                             continue;
                         }
-                        temp     = (1.0 * k + 0.5) * dz + min;
-                        distance = temp - window[i].pos[j]; /* distance to umbrella center */
-                        if (opt->bCycl)
-                        {                             /* in cyclic wham:             */
-                            if (distance > ztot_half) /*    |distance| < ztot_half   */
-                            {
-                                distance -= ztot;
-                            }
-                            else if (distance < -ztot_half)
-                            {
-                                distance += ztot;
-                            }
-                        }
-
-                        if (!opt->bTab)
-                        {
-                            U = 0.5 * window[i].k[j] * gmx::square(distance); /* harmonic potential assumed. */
-                        }
-                        else
-                        {
-                            U = tabulated_pot(distance, opt); /* Use tabulated potential     */
-                        }
-                        total += profile[k] * std::exp(-U / (BOLTZ * opt->Temperature));
+                        total += profile[k] * window[i].boltzFactor[j][k];
                     }
                     /* Avoid floating point exception if window is far outside min and max */
                     if (total != 0.0)
@@ -1261,14 +1297,16 @@ static void getRandomIntArray(int nPull, int blockLength, int* randomArray, gmx:
  */
 static void copy_pullgrp_to_synthwindow(t_UmbrellaWindow* synthWindow, t_UmbrellaWindow* thisWindow, int pullid)
 {
-    synthWindow->N[0]        = thisWindow->N[pullid];
-    synthWindow->Histo[0]    = thisWindow->Histo[pullid];
-    synthWindow->pos[0]      = thisWindow->pos[pullid];
-    synthWindow->z[0]        = thisWindow->z[pullid];
-    synthWindow->k[0]        = thisWindow->k[pullid];
-    synthWindow->bContrib[0] = thisWindow->bContrib[pullid];
-    synthWindow->g[0]        = thisWindow->g[pullid];
-    synthWindow->bsWeight[0] = thisWindow->bsWeight[pullid];
+    synthWindow->N[0]             = thisWindow->N[pullid];
+    synthWindow->Histo[0]         = thisWindow->Histo[pullid];
+    synthWindow->pos[0]           = thisWindow->pos[pullid];
+    synthWindow->z[0]             = thisWindow->z[pullid];
+    synthWindow->k[0]             = thisWindow->k[pullid];
+    synthWindow->bContrib[0]      = thisWindow->bContrib[pullid];
+    synthWindow->boltzFactor[0]   = thisWindow->boltzFactor[pullid];
+    synthWindow->boltzExponent[0] = thisWindow->boltzExponent[pullid];
+    synthWindow->g[0]             = thisWindow->g[pullid];
+    synthWindow->bsWeight[0]      = thisWindow->bsWeight[pullid];
 }
 
 /*! \brief Calculate cumulative distribution function of of all histograms.
@@ -1414,13 +1452,15 @@ static void create_synthetic_histo(t_UmbrellaWindow*  synthWindow,
         gmx_fatal(FARGS, "%s", errstr);
     }
 
-    synthWindow->N[0]        = N;
-    synthWindow->pos[0]      = thisWindow->pos[pullid];
-    synthWindow->z[0]        = thisWindow->z[pullid];
-    synthWindow->k[0]        = thisWindow->k[pullid];
-    synthWindow->bContrib[0] = thisWindow->bContrib[pullid];
-    synthWindow->g[0]        = thisWindow->g[pullid];
-    synthWindow->bsWeight[0] = thisWindow->bsWeight[pullid];
+    synthWindow->N[0]             = N;
+    synthWindow->pos[0]           = thisWindow->pos[pullid];
+    synthWindow->z[0]             = thisWindow->z[pullid];
+    synthWindow->k[0]             = thisWindow->k[pullid];
+    synthWindow->bContrib[0]      = thisWindow->bContrib[pullid];
+    synthWindow->boltzFactor[0]   = thisWindow->boltzFactor[pullid];
+    synthWindow->boltzExponent[0] = thisWindow->boltzExponent[pullid];
+    synthWindow->g[0]             = thisWindow->g[pullid];
+    synthWindow->bsWeight[0]      = thisWindow->bsWeight[pullid];
 
     for (i = 0; i < nbins; i++)
     {
@@ -1660,6 +1700,8 @@ static void do_bootstrapping(const char*        fnres,
         snew(synthWindow[i].z, 1);
         snew(synthWindow[i].k, 1);
         snew(synthWindow[i].bContrib, 1);
+        snew(synthWindow[i].boltzFactor, 1);
+        snew(synthWindow[i].boltzExponent, 1);
         snew(synthWindow[i].g, 1);
         snew(synthWindow[i].bsWeight, 1);
     }
@@ -1750,7 +1792,7 @@ static void do_bootstrapping(const char*        fnres,
             }
             calc_profile(bsProfile, synthWindow, nAllPull, opt, bExact);
             i++;
-        } while ((maxchange = calc_z(bsProfile, synthWindow, nAllPull, opt, bExact)) > opt->Tolerance
+        } while ((maxchange = calc_z(bsProfile, synthWindow, nAllPull, bExact)) > opt->Tolerance
                  || !bExact);
         printf("\tConverged in %d iterations. Final maximum change %g\n", i, maxchange);
 
@@ -3167,7 +3209,8 @@ static void guessPotByIntegration(t_UmbrellaWindow* window, int nWindows, t_Umbr
     {
         pot[j] = std::exp(-pot[j] / (BOLTZ * opt->Temperature));
     }
-    calc_z(pot, window, nWindows, opt, TRUE);
+    setup_boltzmann_factors(window, nWindows, opt);
+    calc_z(pot, window, nWindows, TRUE);
 
     sfree(pot);
     sfree(f);
@@ -3797,6 +3840,7 @@ int gmx_wham(int argc, char* argv[])
 
     /* Calculate profile */
     snew(profile, opt.bins);
+    setup_boltzmann_factors(window, nwins, &opt);
     if (opt.verbose)
     {
         opt.stepchange = 1;
@@ -3820,7 +3864,7 @@ int gmx_wham(int argc, char* argv[])
             printf("\t%4d) Maximum change %e\n", i, maxchange);
         }
         i++;
-    } while ((maxchange = calc_z(profile, window, nwins, &opt, bExact)) > opt.Tolerance || !bExact);
+    } while ((maxchange = calc_z(profile, window, nwins, bExact)) > opt.Tolerance || !bExact);
     printf("Converged in %d iterations. Final maximum change %g\n", i, maxchange);
 
     /* calc error from Kumar's formula */
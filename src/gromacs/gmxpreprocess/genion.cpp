@@ -55,6 +55,7 @@
 #include "gromacs/pbcutil/pbc.h"
 #include "gromacs/random/threefry.h"
 #include "gromacs/random/uniformintdistribution.h"
+#include "gromacs/selection/nbsearch.h"
 #include "gromacs/topology/index.h"
 #include "gromacs/topology/topology.h"
 #include "gromacs/utility/arrayref.h"
@@ -66,37 +67,33 @@
 #include "gromacs/utility/smalloc.h"
 
 
-/*! \brief Return whether any atoms of two groups are below minimum distance.
+/*! \brief Mark solvent molecules that are closer than the minimum distance to given positions.
  *
- * \param[in] pbc the periodic boundary conditions
- * \param[in] x the coordinates
- * \param[in] smallerGroupIndices the atom indices of the first group to check
- * \param[in] largerGroupIndices the atom indices of the second group to check
- * \param[in] minimumDistance the minimum required distance betwenn any atom in
- *                            the first and second group
- * \returns true if any distance between an atom from group A and group B is
- *               smaller than a minimum distance.
+ * \param[in] solventSearch neighborhood search over the solvent atoms, in
+ *                          solvent group order, with the minimum distance as cutoff
+ * \param[in] positions the positions to keep the solvent away from
+ * \param[in] numberAtomsPerSolventMolecule how many atoms each solvent molecule contains
+ * \param[in] minimumDistance the minimum required distance between any solvent
+ *                            molecule atom and any of the positions
+ * \param[in,out] excludedSolventMolecules true for each solvent molecule that
+ *                                        can no longer be replaced by an ion
  */
-static bool groupsCloserThanCutoffWithPbc(t_pbc*                   pbc,
-                                          rvec                     x[],
-                                          gmx::ArrayRef<const int> smallerGroupIndices,
-                                          gmx::ArrayRef<const int> largerGroupIndices,
-                                          real                     minimumDistance)
+static void excludeSolventCloserThanCutoff(gmx::AnalysisNeighborhoodSearch*          solventSearch,
+                                           const gmx::AnalysisNeighborhoodPositions& positions,
+                                           int                numberAtomsPerSolventMolecule,
+                                           real               minimumDistance,
+                                           std::vector<bool>* excludedSolventMolecules)
 {
-    const real minimumDistance2 = minimumDistance * minimumDistance;
-    for (int aIndex : largerGroupIndices)
+    const real                          minimumDistance2 = minimumDistance * minimumDistance;
+    gmx::AnalysisNeighborhoodPairSearch pairSearch = solventSearch->startPairSearch(positions);
+    gmx::AnalysisNeighborhoodPair       pair;
+    while (pairSearch.findNextPair(&pair))
     {
-        for (int bIndex : smallerGroupIndices)
+        if (pair.distance2() < minimumDistance2)
         {
-            rvec dx;
-            pbc_dx(pbc, x[aIndex], x[bIndex], dx);
-            if (norm2(dx) < minimumDistance2)
-            {
-                return true;
-            }
+            (*excludedSolventMolecules)[pair.refIndex() / numberAtomsPerSolventMolecule] = true;
         }
     }
-    return false;
 }
 
 /*! \brief Calculate the solvent molecule atom indices from molecule number.
@@ -122,32 +119,24 @@ static std::vector<int> solventMoleculeIndices(int solventMoleculeNumber,
     return indices;
 }
 
-static void insert_ion(int                      nsa,
-                       std::vector<int>*        solventMoleculesForReplacement,
-                       int                      repl[],
-                       gmx::ArrayRef<const int> index,
-                       rvec                     x[],
-                       t_pbc*                   pbc,
-                       int                      sign,
-                       int                      q,
-                       const char*              ionname,
-                       t_atoms*                 atoms,
-                       real                     rmin,
-                       std::vector<int>*        notSolventGroup)
+static void insert_ion(int                              nsa,
+                       std::vector<int>*                solventMoleculesForReplacement,
+                       int                              repl[],
+                       gmx::ArrayRef<const int>         index,
+                       rvec                             x[],
+                       int                              sign,
+                       int                              q,
+                       const char*                      ionname,
+                       t_atoms*                         atoms,
+                       real                             rmin,
+                       gmx::AnalysisNeighborhoodSearch* solventSearch,
+                       std::vector<bool>*               excludedSolventMolecules)
 {
-    std::vector<int> solventMoleculeAtomsToBeReplaced =
-            solventMoleculeIndices(solventMoleculesForReplacement->back(), nsa, index);
-
-    if (rmin > 0.0)
+    // skip molecules close to non-solvent or to previously placed ions
+    while (!solventMoleculesForReplacement->empty()
+           && (*excludedSolventMolecules)[solventMoleculesForReplacement->back()])
     {
-        // check for proximity to non-solvent
-        while (groupsCloserThanCutoffWithPbc(pbc, x, solventMoleculeAtomsToBeReplaced, *notSolventGroup, rmin)
-               && !solventMoleculesForReplacement->empty())
-        {
-            solventMoleculesForReplacement->pop_back();
-            solventMoleculeAtomsToBeReplaced =
-                    solventMoleculeIndices(solventMoleculesForReplacement->back(), nsa, index);
-        }
+        solventMoleculesForReplacement->pop_back();
     }
 
     if (solventMoleculesForReplacement->empty())
@@ -155,11 +144,19 @@ static void insert_ion(int                      nsa,
         gmx_fatal(FARGS, "No more replaceable solvent!");
     }
 
+    std::vector<int> solventMoleculeAtomsToBeReplaced =
+            solventMoleculeIndices(solventMoleculesForReplacement->back(), nsa, index);
+
     fprintf(stderr, "Replacing solvent molecule %d (atom %d) with %s\n",
             solventMoleculesForReplacement->back(), solventMoleculeAtomsToBeReplaced[0], ionname);
 
     /* Replace solvent molecule charges with ion charge */
-    notSolventGroup->push_back(solventMoleculeAtomsToBeReplaced[0]);
+    if (rmin > 0.0)
+    {
+        excludeSolventCloserThanCutoff(
+                solventSearch, gmx::AnalysisNeighborhoodPositions(x[solventMoleculeAtomsToBeReplaced[0]]),
+                nsa, rmin, excludedSolventMolecules);
+    }
     repl[solventMoleculesForReplacement->back()] = sign;
 
     // The first solvent molecule atom is replaced with an ion and the respective
@@ -631,7 +628,33 @@ int gmx_genion(int argc, char* argv[])
         fprintf(stderr, "Using random seed %d.\n", seed);
 
 
-        std::vector<int> notSolventGroup = invertIndexGroup(atoms.nr, solventGroup);
+        /* Solvent molecules within rmin of non-solvent atoms or of placed
+         * ions are excluded from replacement. The exclusion is updated with
+         * a grid search around each new ion, so placement does not scale
+         * with the system size or the number of ions already placed.
+         */
+        std::vector<bool>               excludedSolventMolecules(nw, false);
+        std::vector<gmx::RVec>          solventX;
+        gmx::AnalysisNeighborhood       nb;
+        gmx::AnalysisNeighborhoodSearch solventSearch;
+        if (rmin > 0.0)
+        {
+            solventX.reserve(solventGroup.size());
+            for (int i : solventGroup)
+            {
+                solventX.emplace_back(x[i]);
+            }
+            nb.setCutoff(rmin);
+            solventSearch = nb.initSearch(&pbc, gmx::AnalysisNeighborhoodPositions(solventX));
+
+            std::vector<gmx::RVec> notSolventX;
+            for (int i : invertIndexGroup(atoms.nr, solventGroup))
+            {
+                notSolventX.emplace_back(x[i]);
+            }
+            excludeSolventCloserThanCutoff(&solventSearch, gmx::AnalysisNeighborhoodPositions(notSolventX),
+                                           nsa, rmin, &excludedSolventMolecules);
+        }
 
         std::vector<int> solventMoleculesForReplacement(nw);
         std::iota(std::begin(solventMoleculesForReplacement), std::end(solventMoleculesForReplacement), 0);
@@ -645,13 +668,13 @@ int gmx_genion(int argc, char* argv[])
         /* Now loop over the ions that have to be placed */
         while (p_num-- > 0)
         {
-            insert_ion(nsa, &solventMoleculesForReplacement, repl, solventGroup, x, &pbc, 1, p_q,
-                       p_name, &atoms, rmin, &notSolventGroup);
+            insert_ion(nsa, &solventMoleculesForReplacement, repl, solventGroup, x, 1, p_q,
+                       p_name, &atoms, rmin, &solventSearch, &excludedSolventMolecules);
         }
         while (n_num-- > 0)
         {
-            insert_ion(nsa, &solventMoleculesForReplacement, repl, solventGroup, x, &pbc, -1, n_q,
-                       n_name, &atoms, rmin, &notSolventGroup);
+            insert_ion(nsa, &solventMoleculesForReplacement, repl, solventGroup, x, -1, n_q,
+                       n_name, &atoms, rmin, &solventSearch, &excludedSolventMolecules);
         }
         fprintf(stderr, "\n");
 
@@ -232,6 +232,58 @@ void InteractionOfType::setForceParameter(int pos, real value)
     forceParam_[pos] = value;
 }
 
+size_t InteractionsOfType::AtomsKeyHash::operator()(const AtomsKey& key) const
+{
+    size_t hash = 0;
+    for (const int atom : key)
+    {
+        hash = hash * 31 + std::hash<int>()(atom);
+    }
+    return hash;
+}
+
+InteractionsOfType::AtomsKey InteractionsOfType::atomsKey(gmx::ArrayRef<const int> atoms)
+{
+    GMX_RELEASE_ASSERT(atoms.size() <= MAXATOMLIST,
+                       "Interactions can not have more atoms than MAXATOMLIST");
+    AtomsKey key;
+    key.fill(-1);
+    std::copy(atoms.begin(), atoms.end(), key.begin());
+    return key;
+}
+
+void InteractionsOfType::addInteractionType(InteractionOfType&& type)
+{
+    interactionTypes.emplace_back(std::move(type));
+    if (numIndexed_ + 1 == interactionTypes.size())
+    {
+        atomsIndex_[atomsKey(interactionTypes.back().atoms())].push_back(numIndexed_);
+        numIndexed_++;
+    }
+}
+
+void InteractionsOfType::buildAtomsIndex()
+{
+    atomsIndex_.clear();
+    for (numIndexed_ = 0; numIndexed_ < interactionTypes.size(); numIndexed_++)
+    {
+        atomsIndex_[atomsKey(interactionTypes[numIndexed_].atoms())].push_back(numIndexed_);
+    }
+}
+
+gmx::ArrayRef<const int>
+InteractionsOfType::findInteractionTypes(gmx::ArrayRef<const int> atoms) const
+{
+    GMX_RELEASE_ASSERT(numIndexed_ == interactionTypes.size(),
+                       "The atoms index should be rebuilt after changing the interaction types");
+    const auto found = atomsIndex_.find(atomsKey(atoms));
+    if (found == atomsIndex_.end())
+    {
+        return {};
+    }
+    return found->second;
+}
+
 void MoleculeInformation::initMolInfo()
 {
     init_block(&mols);
@@ -38,12 +38,16 @@
 #ifndef GMX_GMXPREPROCESS_GROMPP_IMPL_H
 #define GMX_GMXPREPROCESS_GROMPP_IMPL_H
 
+#include <array>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "gromacs/gmxpreprocess/notset.h"
 #include "gromacs/topology/atoms.h"
 #include "gromacs/topology/block.h"
 #include "gromacs/topology/idef.h"
+#include "gromacs/topology/ifunc.h"
 #include "gromacs/utility/arrayref.h"
 #include "gromacs/utility/basedefinitions.h"
 #include "gromacs/utility/exceptions.h"
@@ -149,6 +153,41 @@ struct InteractionsOfType
     int ncmap() const { return cmap.size(); }
     //! Number of elements in cmapAtomTypes.
     int nct() const { return cmapAtomTypes.size(); }
+    /*! \brief Append an interaction type and add it to the atoms index.
+     *
+     * Use this instead of changing \c interactionTypes directly when
+     * findInteractionTypes() should remain usable without rebuilding the index.
+     */
+    void addInteractionType(InteractionOfType&& type);
+    /*! \brief (Re)build the index of \c interactionTypes by their atoms.
+     *
+     * Has to be called after \c interactionTypes has been changed other
+     * than through addInteractionType() and before findInteractionTypes().
+     */
+    void buildAtomsIndex();
+    /*! \brief Return the positions in \c interactionTypes of the types with exactly \p atoms.
+     *
+     * The positions are returned in increasing order.
+     * Requires that the atoms index is up to date.
+     */
+    gmx::ArrayRef<const int> findInteractionTypes(gmx::ArrayRef<const int> atoms) const;
+
+private:
+    //! Atom (type) indices of an interaction, padded with -1.
+    using AtomsKey = std::array<int, MAXATOMLIST>;
+    //! Hash function for \c AtomsKey.
+    struct AtomsKeyHash
+    {
+        //! Return the hash of \p key.
+        size_t operator()(const AtomsKey& key) const;
+    };
+    //! Return the key for \p atoms.
+    static AtomsKey atomsKey(gmx::ArrayRef<const int> atoms);
+
+    //! Positions in \c interactionTypes of each set of atoms, in increasing order.
+    std::unordered_map<AtomsKey, std::vector<int>, AtomsKeyHash> atomsIndex_;
+    //! Number of entries of \c interactionTypes present in \c atomsIndex_.
+    size_t numIndexed_ = 0;
 };
 
 struct t_excls
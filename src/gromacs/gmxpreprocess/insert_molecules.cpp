@@ -243,6 +243,10 @@ static void insert_mols(int                  nmol_insrt,
     int                                firstTrial = 0;
     int                                failed     = 0;
     gmx::UniformRealDistribution<real> dist;
+    // The existing positions only change when a molecule is inserted,
+    // so the search is only initialized again after a successful trial.
+    gmx::AnalysisNeighborhoodSearch search;
+    bool                            searchIsValid = false;
 
     while (mol < nmol_insrt && trial < ntry * nmol_insrt)
     {
@@ -275,8 +279,12 @@ static void insert_mols(int                  nmol_insrt,
         fflush(stderr);
 
         generate_trial_conf(x_insrt, offset_x, enum_rot, &rng, &x_n);
-        gmx::AnalysisNeighborhoodPositions pos(*x);
-        gmx::AnalysisNeighborhoodSearch    search = nb.initSearch(&pbc, pos);
+        if (!searchIsValid)
+        {
+            gmx::AnalysisNeighborhoodPositions pos(*x);
+            search        = nb.initSearch(&pbc, pos);
+            searchIsValid = true;
+        }
         if (isInsertionAllowed(&search, exclusionDistances, x_n, exclusionDistances_insrt, *atoms,
                                removableAtoms, &remover))
         {
@@ -284,6 +292,7 @@ static void insert_mols(int                  nmol_insrt,
             exclusionDistances.insert(exclusionDistances.end(), exclusionDistances_insrt.begin(),
                                       exclusionDistances_insrt.end());
             builder.mergeAtoms(atoms_insrt);
+            searchIsValid = false;
             ++mol;
             firstTrial = trial;
             fprintf(stderr, " success (now %d atoms)!\n", builder.currentAtomCount());
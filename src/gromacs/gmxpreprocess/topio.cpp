@@ -135,6 +135,7 @@ static void gen_pairs(const InteractionsOfType& nbs, InteractionsOfType* pairs,
         pairs->interactionTypes.emplace_back(InteractionOfType(atomNumbers, forceParam));
         i++;
     }
+    pairs->buildAtomsIndex();
 }
 
 double check_mol(const gmx_mtop_t* mtop, warninp* wi)
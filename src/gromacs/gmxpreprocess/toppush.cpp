@@ -617,12 +617,20 @@ static void push_bondtype(InteractionsOfType*      bt,
     }
 
     /* Search for earlier duplicates if this entry was not a continuation
-       from the previous line.
+       from the previous line. Types are stored in both directions, so we
+       look up the types matching our atoms in either order.
      */
+    std::vector<int>         reversedAtoms(b.atoms().rbegin(), b.atoms().rend());
+    gmx::ArrayRef<const int> forwardMatches = bt->findInteractionTypes(b.atoms());
+    gmx::ArrayRef<const int> reverseMatches = bt->findInteractionTypes(reversedAtoms);
+    std::vector<int>         duplicates;
+    std::set_union(forwardMatches.begin(), forwardMatches.end(), reverseMatches.begin(),
+                   reverseMatches.end(), std::back_inserter(duplicates));
+
     bool addBondType = true;
     bool haveWarned  = false;
     bool haveErrored = false;
-    for (int i = 0; (i < nr); i++)
+    for (int i : duplicates)
     {
         gmx::ArrayRef<const int> bParams    = b.atoms();
         gmx::ArrayRef<const int> testParams = bt->interactionTypes[i].atoms();
@@ -707,7 +715,7 @@ static void push_bondtype(InteractionsOfType*      bt,
     if (addBondType)
     {
         /* fill the arrays up and down */
-        bt->interactionTypes.emplace_back(
+        bt->addInteractionType(
                 InteractionOfType(b.atoms(), b.forceParam(), b.interactionTypeName()));
         /* need to store force values because they might change below */
         std::vector<real> forceParam(b.forceParam().begin(), b.forceParam().end());
@@ -727,7 +735,7 @@ static void push_bondtype(InteractionsOfType*      bt,
         {
             atoms.emplace_back(*oldAtom);
         }
-        bt->interactionTypes.emplace_back(InteractionOfType(atoms, forceParam, b.interactionTypeName()));
+        bt->addInteractionType(InteractionOfType(atoms, forceParam, b.interactionTypeName()));
     }
 }
 
@@ -1715,42 +1723,6 @@ static int findNumberOfDihedralAtomMatches(const InteractionOfType& currentParam
     }
 }
 
-static bool findIfAllParameterAtomsMatch(gmx::ArrayRef<const int>      atomsFromParameterArray,
-                                         gmx::ArrayRef<const int>      atomsFromCurrentParameter,
-                                         const t_atoms*                at,
-                                         const PreprocessingAtomTypes* atypes,
-                                         bool                          bB)
-{
-    if (atomsFromParameterArray.size() != atomsFromCurrentParameter.size())
-    {
-        return false;
-    }
-    else if (bB)
-    {
-        for (gmx::index i = 0; i < atomsFromCurrentParameter.ssize(); i++)
-        {
-            if (atypes->bondAtomTypeFromAtomType(at->atom[atomsFromCurrentParameter[i]].typeB)
-                != atomsFromParameterArray[i])
-            {
-                return false;
-            }
-        }
-        return true;
-    }
-    else
-    {
-        for (gmx::index i = 0; i < atomsFromCurrentParameter.ssize(); i++)
-        {
-            if (atypes->bondAtomTypeFromAtomType(at->atom[atomsFromCurrentParameter[i]].type)
-                != atomsFromParameterArray[i])
-            {
-                return false;
-            }
-        }
-        return true;
-    }
-}
-
 static std::vector<InteractionOfType>::iterator defaultInteractionsOfType(int ftype,
                                                                           gmx::ArrayRef<InteractionsOfType> bt,
                                                                           t_atoms* at,
@@ -1776,20 +1748,17 @@ static std::vector<InteractionOfType>::iterator defaultInteractionsOfType(int ft
 
         /* For dihedrals we allow wildcards. We choose the first type
          * that has the most real matches, i.e. non-wildcard matches.
+         * This is found in a single pass, which can stop at a full match.
          */
         auto prevPos = bt[ftype].interactionTypes.end();
-        auto pos     = bt[ftype].interactionTypes.begin();
-        while (pos != bt[ftype].interactionTypes.end() && nmatch_max < 4)
-        {
-            pos = std::find_if(bt[ftype].interactionTypes.begin(), bt[ftype].interactionTypes.end(),
-                               [&p, &at, &atypes, &bB, &nmatch_max](const auto& param) {
-                                   return (findNumberOfDihedralAtomMatches(param, p, at, atypes, bB)
-                                           > nmatch_max);
-                               });
-            if (pos != bt[ftype].interactionTypes.end())
+        for (auto pos = bt[ftype].interactionTypes.begin();
+             pos != bt[ftype].interactionTypes.end() && nmatch_max < 4; ++pos)
+        {
+            int nmatch = findNumberOfDihedralAtomMatches(*pos, p, at, atypes, bB);
+            if (nmatch > nmatch_max)
             {
                 prevPos    = pos;
-                nmatch_max = findNumberOfDihedralAtomMatches(*pos, p, at, atypes, bB);
+                nmatch_max = nmatch;
             }
         }
 
@@ -1827,14 +1796,19 @@ static std::vector<InteractionOfType>::iterator defaultInteractionsOfType(int ft
     }
     else /* Not a dihedral */
     {
+        /* Look up the first type with exactly our bond atom types */
         gmx::ArrayRef<const int> atomParam = p.atoms();
-        auto                     found     = std::find_if(
-                bt[ftype].interactionTypes.begin(), bt[ftype].interactionTypes.end(),
-                [&atomParam, &at, &atypes, &bB](const auto& param) {
-                    return findIfAllParameterAtomsMatch(param.atoms(), atomParam, at, atypes, bB);
-                });
-        if (found != bt[ftype].interactionTypes.end())
+        std::vector<int>         bondAtomTypes;
+        for (int atom : atomParam)
+        {
+            bondAtomTypes.push_back(atypes->bondAtomTypeFromAtomType(bB ? at->atom[atom].typeB
+                                                                        : at->atom[atom].type));
+        }
+        gmx::ArrayRef<const int> matches = bt[ftype].findInteractionTypes(bondAtomTypes);
+        auto                     found   = bt[ftype].interactionTypes.end();
+        if (!matches.empty())
         {
+            found        = bt[ftype].interactionTypes.begin() + matches[0];
             nparam_found = 1;
         }
         *nparam_def = nparam_found;
@@ -54,6 +54,14 @@
 #include <cerrno>
 #include <cstring>
 
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
 #include "gromacs/commandline/filenm.h"
 #include "gromacs/domdec/domdec_struct.h"
 #include "gromacs/domdec/ga2la.h"
@@ -136,6 +144,8 @@ typedef struct
 } IMDHeader;
 
 
+class ImdSender;
+
 /*! \internal
  * \brief Implementation type for the IMD session
  *
@@ -246,6 +256,8 @@ public:
     IMDSocket* socket = nullptr;
     //! The IMD socket on the client.
     IMDSocket* clientsocket = nullptr;
+    //! Sends positions and energies to the client, present while connected.
+    std::unique_ptr<ImdSender> sender;
     //! Length we got with last header.
     int length = 0;
 
@@ -569,6 +581,138 @@ static int imd_send_rvecs(IMDSocket* socket, int nat, rvec* x, char* buffer)
 }
 
 
+/*! \internal
+ * \brief Sends positions and energies to the IMD client on a separate thread.
+ *
+ * Writing to the socket blocks when the client does not read fast enough.
+ * So that a slow client does not stall the simulation, the MD thread only
+ * copies a frame and returns. A frame that has not been sent yet when the
+ * next one arrives is replaced by the newer frame.
+ */
+class ImdSender
+{
+public:
+    /*! \brief Starts the sender thread.
+     *
+     * \param[in] socket         The client socket to write to.
+     * \param[in] nat            The number of IMD atoms.
+     * \param[in] energysendbuf  Send buffer for the energies, only used by the sender thread.
+     * \param[in] coordsendbuf   Send buffer for the positions, only used by the sender thread.
+     */
+    ImdSender(IMDSocket* socket, int nat, char* energysendbuf, char* coordsendbuf) :
+        socket_(socket),
+        energysendbuf_(energysendbuf),
+        coordsendbuf_(coordsendbuf),
+        pendingX_(nat),
+        sendX_(nat)
+    {
+        thread_ = std::thread([this]() { run(); });
+    }
+    /*! \brief Shuts down the socket and stops the sender thread, unsent frames are dropped.
+     *
+     * The socket is shut down first, so that a send that blocks on a client
+     * that does not read returns and the thread can be joined.
+     */
+    ~ImdSender()
+    {
+        imdsock_shutdown(socket_);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        frameQueued_.notify_one();
+        thread_.join();
+    }
+
+    /*! \brief Queues a frame for sending, replacing an unsent older frame.
+     *
+     * \returns An error message when an earlier send failed, empty otherwise.
+     */
+    std::string queueFrame(const IMDEnergyBlock& energies, const rvec* x)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!error_.empty())
+            {
+                return error_;
+            }
+            pendingEnergies_ = energies;
+            for (size_t i = 0; i < pendingX_.size(); i++)
+            {
+                copy_rvec(x[i], pendingX_[i]);
+            }
+            framePending_ = true;
+        }
+        frameQueued_.notify_one();
+
+        return std::string();
+    }
+
+private:
+    //! The sender thread loop.
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true)
+        {
+            frameQueued_.wait(lock, [this]() { return stop_ || framePending_; });
+            if (stop_)
+            {
+                return;
+            }
+            /* Take the frame, so the MD thread can queue the next one while we send */
+            IMDEnergyBlock energies = pendingEnergies_;
+            std::swap(pendingX_, sendX_);
+            framePending_ = false;
+            lock.unlock();
+
+            const char* error = nullptr;
+            if (imd_send_energies(socket_, &energies, energysendbuf_))
+            {
+                error = "Error sending updated energies. Disconnecting client.";
+            }
+            else if (imd_send_rvecs(socket_, static_cast<int>(sendX_.size()),
+                                    as_rvec_array(sendX_.data()), coordsendbuf_))
+            {
+                error = "Error sending updated positions. Disconnecting client.";
+            }
+
+            lock.lock();
+            if (error)
+            {
+                error_ = error;
+                return;
+            }
+        }
+    }
+
+    //! The client socket.
+    IMDSocket* socket_;
+    //! Send buffer for energies.
+    char* energysendbuf_;
+    //! Send buffer for positions.
+    char* coordsendbuf_;
+    //! The sender thread.
+    std::thread thread_;
+    //! Protects the pending frame and the flags below.
+    std::mutex mutex_;
+    //! Signals a queued frame or a stop request.
+    std::condition_variable frameQueued_;
+    //! Energies of the pending frame.
+    IMDEnergyBlock pendingEnergies_;
+    //! Positions of the pending frame.
+    std::vector<RVec> pendingX_;
+    //! Positions of the frame being sent, only used by the sender thread.
+    std::vector<RVec> sendX_;
+    //! Whether a frame is waiting to be sent.
+    bool framePending_ = false;
+    //! Whether the sender thread should stop.
+    bool stop_ = false;
+    //! Error message of a failed send, after which the sender thread has stopped.
+    std::string error_;
+};
+
+
 void ImdSession::Impl::prepareMasterSocket()
 {
     if (imdsock_winsockinit() == -1)
@@ -610,8 +754,17 @@ void ImdSession::Impl::disconnectClient()
     /* Write out any buffered pulling data */
     fflush(outf);
 
-    /* we first try to shut down the clientsocket */
-    imdsock_shutdown(clientsocket);
+    /* we first try to shut down the clientsocket, stopping the sender
+     * thread does that before it joins the thread */
+    if (sender)
+    {
+        sender.reset();
+    }
+    else
+    {
+        imdsock_shutdown(clientsocket);
+    }
+
     if (!imdsock_destroy(clientsocket))
     {
         GMX_LOG(mdlog.warning).appendTextFormatted("%s Failed to destroy socket.", IMDstr);
@@ -1060,6 +1213,10 @@ ImdSession::Impl::Impl(const MDLogger& mdlog) : mdlog(mdlog)
 
 ImdSession::Impl::~Impl()
 {
+    if (clientsocket)
+    {
+        disconnectClient();
+    }
     if (outf)
     {
         gmx_fio_fclose(outf);
@@ -1607,14 +1764,18 @@ void ImdSession::sendPositionsAndEnergies()
         return;
     }
 
-    if (imd_send_energies(impl_->clientsocket, impl_->energies, impl_->energysendbuf))
+    /* The actual sending is done on a separate thread, so a slow client
+     * does not stall the simulation */
+    if (!impl_->sender)
     {
-        impl_->issueFatalError("Error sending updated energies. Disconnecting client.");
+        impl_->sender = std::make_unique<ImdSender>(impl_->clientsocket, impl_->nat,
+                                                    impl_->energysendbuf, impl_->coordsendbuf);
     }
 
-    if (imd_send_rvecs(impl_->clientsocket, impl_->nat, impl_->xa, impl_->coordsendbuf))
+    std::string error = impl_->sender->queueFrame(*impl_->energies, impl_->xa);
+    if (!error.empty())
     {
-        impl_->issueFatalError("Error sending updated positions. Disconnecting client.");
+        impl_->issueFatalError(error.c_str());
     }
 }
 
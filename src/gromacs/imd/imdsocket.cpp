@@ -244,6 +244,11 @@ IMDSocket* imdsock_accept(IMDSocket* sock)
         snew(newsock, 1);
         newsock->address = sock->address;
         newsock->sockfd  = ret;
+#    if defined(SO_NOSIGPIPE)
+        /* Where send() has no MSG_NOSIGNAL, disable SIGPIPE on the socket instead */
+        int noSigPipe = 1;
+        setsockopt(ret, SOL_SOCKET, SO_NOSIGPIPE, &noSigPipe, sizeof(noSigPipe));
+#    endif
 
         return newsock;
     }
@@ -312,6 +317,9 @@ int imdsock_write(IMDSocket* sock, const char* buffer, int length)
     /* No read and write on windows, we have to use send and recv instead... */
 #    if GMX_NATIVE_WINDOWS
     return send(sock->sockfd, (const char*)buffer, length, c_noFlags);
+#    elif defined(MSG_NOSIGNAL)
+    /* Writing to a socket that was shut down should return an error, not raise SIGPIPE */
+    return send(sock->sockfd, buffer, length, MSG_NOSIGNAL);
 #    else
     return write(sock->sockfd, buffer, length);
 #    endif
@@ -45,6 +45,7 @@
 
 #include <algorithm>
 #include <numeric>
+#include <vector>
 
 #include "gromacs/math/multidimarray.h"
 #include "gromacs/math/vec.h"
@@ -59,10 +60,18 @@ public:
     virtual ~DensitySimilarityMeasureImpl();
     //! convenience typedef
     using density = DensitySimilarityMeasure::density;
-    //! \copydoc DensitySimilarityMeasure::gradient(DensitySimilarityMeasure::density comparedDensity)
-    virtual density gradient(density comparedDensity) = 0;
-    //! \copydoc DensitySimilarityMeasure::similarity(density comparedDensity)
-    virtual real similarity(density comparedDensity) = 0;
+    /*! \brief Derivative of the density similarity measure at all voxels.
+     * \param[in] comparedDensity the variable density
+     * \param[in] numThreads number of OpenMP threads to use
+     * \returns density similarity measure derivative
+     */
+    virtual density gradient(density comparedDensity, int numThreads) = 0;
+    /*! \brief Similarity between reference and compared density.
+     * \param[in] comparedDensity the variable density
+     * \param[in] numThreads number of OpenMP threads to use
+     * \returns density similarity
+     */
+    virtual real similarity(density comparedDensity, int numThreads) = 0;
     //! clone to allow copy operations
     virtual std::unique_ptr<DensitySimilarityMeasureImpl> clone() = 0;
 };
@@ -71,6 +80,83 @@ DensitySimilarityMeasureImpl::~DensitySimilarityMeasureImpl() = default;
 namespace
 {
 
+/****************** Voxel loops ***********************************************/
+
+/*! \brief Number of voxels in a block of the threaded voxel loops.
+ *
+ * Sums are accumulated per block and the block sums are added in order,
+ * so that the results do not depend on the number of threads.
+ */
+const index c_voxelsPerBlock = 65536;
+
+//! Return the number of blocks of voxels that cover \p numVoxels voxels
+index numVoxelBlocks(index numVoxels)
+{
+    return std::max<index>(1, (numVoxels + c_voxelsPerBlock - 1) / c_voxelsPerBlock);
+}
+
+/*! \brief Return the number of OpenMP threads for looping over \p numBlocks blocks of voxels.
+ *
+ * Uses at most \p numThreads threads and not more threads than blocks.
+ */
+int numThreadsForVoxelBlocks(int numThreads, index numBlocks)
+{
+    return static_cast<int>(std::max<index>(1, std::min<index>(numThreads, numBlocks)));
+}
+
+/*! \brief Evaluate a function of two densities at every voxel, storing the results.
+ *
+ * With few voxels this is a serial loop.
+ */
+template<typename VoxelFunction>
+void transformVoxels(DensitySimilarityMeasure::density first,
+                     DensitySimilarityMeasure::density second,
+                     float*                            result,
+                     int                               numThreads,
+                     VoxelFunction                     voxelFunction)
+{
+    const index  numVoxels      = first.mapping().required_span_size();
+    const int    numThreadsUsed = numThreadsForVoxelBlocks(numThreads, numVoxelBlocks(numVoxels));
+    const float* firstData      = first.data();
+    const float* secondData     = second.data();
+#pragma omp parallel for num_threads(numThreadsUsed) schedule(static)
+    for (index i = 0; i < numVoxels; ++i)
+    {
+        result[i] = voxelFunction(firstData[i], secondData[i]);
+    }
+}
+
+/*! \brief Sum a function of two densities over all voxels.
+ *
+ * The voxels are summed in order within each block, the block sums are
+ * then summed in block order. With few voxels, this is a serial loop.
+ */
+template<typename VoxelFunction>
+double sumOverVoxels(DensitySimilarityMeasure::density first,
+                     DensitySimilarityMeasure::density second,
+                     int                               numThreads,
+                     VoxelFunction                     voxelFunction)
+{
+    const index         numVoxels      = first.mapping().required_span_size();
+    const index         numBlocks      = numVoxelBlocks(numVoxels);
+    const int           numThreadsUsed = numThreadsForVoxelBlocks(numThreads, numBlocks);
+    const float*        firstData      = first.data();
+    const float*        secondData     = second.data();
+    std::vector<double> blockSums(numBlocks);
+#pragma omp parallel for num_threads(numThreadsUsed) schedule(static)
+    for (index block = 0; block < numBlocks; ++block)
+    {
+        const index blockEnd = std::min((block + 1) * c_voxelsPerBlock, numVoxels);
+        double      blockSum = 0;
+        for (index i = block * c_voxelsPerBlock; i < blockEnd; ++i)
+        {
+            blockSum += voxelFunction(firstData[i], secondData[i]);
+        }
+        blockSums[block] = blockSum;
+    }
+    return std::accumulate(std::begin(blockSums), std::end(blockSums), 0.);
+}
+
 /****************** Inner Product *********************************************/
 
 /*! \internal
@@ -84,11 +170,11 @@ public:
     //! Construct similarity measure by setting the reference density
     DensitySimilarityInnerProduct(density referenceDensity);
     //! The gradient for the inner product similarity measure is the reference density divided by the number of voxels
-    density gradient(density comparedDensity) override;
+    density gradient(density comparedDensity, int numThreads) override;
     //! Clone this
     std::unique_ptr<DensitySimilarityMeasureImpl> clone() override;
     //! The similarity between reference density and compared density
-    real similarity(density comparedDensity) override;
+    real similarity(density comparedDensity, int numThreads) override;
 
 private:
     //! A view on the reference density
@@ -108,7 +194,7 @@ DensitySimilarityInnerProduct::DensitySimilarityInnerProduct(density referenceDe
                    [numVoxels](float x) { return x / numVoxels; });
 }
 
-real DensitySimilarityInnerProduct::similarity(density comparedDensity)
+real DensitySimilarityInnerProduct::similarity(density comparedDensity, int numThreads)
 {
     if (comparedDensity.extents() != referenceDensity_.extents())
     {
@@ -116,10 +202,12 @@ real DensitySimilarityInnerProduct::similarity(density comparedDensity)
     }
     /* the similarity measure uses the gradient instead of the reference,
      * here, because it is the reference density divided by the number of voxels */
-    return std::inner_product(begin(gradient_), end(gradient_), begin(comparedDensity), 0.);
+    return sumOverVoxels(gradient_.asConstView(), comparedDensity, numThreads,
+                         [](float gradient, float compared) { return gradient * compared; });
 }
 
-DensitySimilarityMeasure::density DensitySimilarityInnerProduct::gradient(density comparedDensity)
+DensitySimilarityMeasure::density DensitySimilarityInnerProduct::gradient(density comparedDensity,
+                                                                          int     /*numThreads*/)
 {
     /* even though the gradient density does not depend on the compad density,
      * still checking the extents to make sure we're consistent */
@@ -169,11 +257,11 @@ public:
     //! Construct similarity measure by setting the reference density
     DensitySimilarityRelativeEntropy(density referenceDensity);
     //! The gradient for the relative entropy similarity measure
-    density gradient(density comparedDensity) override;
+    density gradient(density comparedDensity, int numThreads) override;
     //! Clone this
     std::unique_ptr<DensitySimilarityMeasureImpl> clone() override;
     //! The similarity between reference density and compared density
-    real similarity(density comparedDensity) override;
+    real similarity(density comparedDensity, int numThreads) override;
 
 private:
     //! A view on the reference density
@@ -188,24 +276,24 @@ DensitySimilarityRelativeEntropy::DensitySimilarityRelativeEntropy(density refer
 {
 }
 
-real DensitySimilarityRelativeEntropy::similarity(density comparedDensity)
+real DensitySimilarityRelativeEntropy::similarity(density comparedDensity, int numThreads)
 {
     if (comparedDensity.extents() != referenceDensity_.extents())
     {
         GMX_THROW(RangeError("Reference density and compared density need to have same extents."));
     }
-    return std::inner_product(begin(referenceDensity_), end(referenceDensity_),
-                              begin(comparedDensity), 0., std::plus<>(), relativeEntropyAtVoxel);
+    return sumOverVoxels(referenceDensity_, comparedDensity, numThreads, relativeEntropyAtVoxel);
 }
 
-DensitySimilarityMeasure::density DensitySimilarityRelativeEntropy::gradient(density comparedDensity)
+DensitySimilarityMeasure::density DensitySimilarityRelativeEntropy::gradient(density comparedDensity,
+                                                                             int     numThreads)
 {
     if (comparedDensity.extents() != referenceDensity_.extents())
     {
         GMX_THROW(RangeError("Reference density and compared density need to have same extents."));
     }
-    std::transform(begin(referenceDensity_), end(referenceDensity_), begin(comparedDensity),
-                   begin(gradient_), relativeEntropyGradientAtVoxel);
+    transformVoxels(referenceDensity_, comparedDensity, gradient_.asView().data(), numThreads,
+                    relativeEntropyGradientAtVoxel);
     return gradient_.asConstView();
 }
 
@@ -231,35 +319,94 @@ struct CrossCorrelationEvaluationHelperValues
     real covariance = 0;
 };
 
-/*! \brief Calculate helper values for the cross-correlation.
+/*! \brief Calculate helper values for the cross-correlation over a range of voxels.
 
  * Enables numerically stable single-pass cross-correlation evaluation algorithm
  * as described in Bennett, J., Grout, R. , Pebay, P., Roe D., Thompson D.
  * "Numerically Stable, Single-Pass, Parallel Statistics Algorithms"
  * and implemented in boost's correlation coefficient
  */
-CrossCorrelationEvaluationHelperValues evaluateHelperValues(DensitySimilarityMeasure::density reference,
-                                                            DensitySimilarityMeasure::density compared)
+CrossCorrelationEvaluationHelperValues evaluateHelperValues(const float* reference,
+                                                            const float* compared,
+                                                            index        numVoxels)
 {
     CrossCorrelationEvaluationHelperValues helperValues;
 
-    index i = 0;
-
-    auto referenceIterator = begin(reference);
-    for (const real comp : compared)
+    for (index i = 0; i < numVoxels; ++i)
     {
-        const real refHelper        = *referenceIterator - helperValues.meanReference;
-        const real comparisonHelper = comp - helperValues.meanComparison;
+        const real refHelper        = reference[i] - helperValues.meanReference;
+        const real comparisonHelper = compared[i] - helperValues.meanComparison;
         helperValues.referenceSquaredSum += (i * square(refHelper)) / (i + 1);
         helperValues.comparisonSquaredSum += (i * square(comparisonHelper)) / (i + 1);
         helperValues.covariance += i * refHelper * comparisonHelper / (i + 1);
         helperValues.meanReference += refHelper / (i + 1);
         helperValues.meanComparison += comparisonHelper / (i + 1);
+    }
+
+    return helperValues;
+}
+
+/*! \brief Combine the helper values of two disjoint voxel ranges.
+ *
+ * Uses the pairwise update from the same publication as evaluateHelperValues().
+ */
+CrossCorrelationEvaluationHelperValues combineHelperValues(const CrossCorrelationEvaluationHelperValues& first,
+                                                           index numFirst,
+                                                           const CrossCorrelationEvaluationHelperValues& second,
+                                                           index numSecond)
+{
+    const real deltaReference  = second.meanReference - first.meanReference;
+    const real deltaComparison = second.meanComparison - first.meanComparison;
+    const real numTotal        = numFirst + numSecond;
+    const real weight          = (real(numFirst) * real(numSecond)) / numTotal;
+
+    CrossCorrelationEvaluationHelperValues combined;
+    combined.meanReference  = first.meanReference + deltaReference * numSecond / numTotal;
+    combined.meanComparison = first.meanComparison + deltaComparison * numSecond / numTotal;
+    combined.referenceSquaredSum =
+            first.referenceSquaredSum + second.referenceSquaredSum + weight * square(deltaReference);
+    combined.comparisonSquaredSum = first.comparisonSquaredSum + second.comparisonSquaredSum
+                                    + weight * square(deltaComparison);
+    combined.covariance =
+            first.covariance + second.covariance + weight * deltaReference * deltaComparison;
+    return combined;
+}
+
+/*! \brief Calculate helper values for the cross-correlation.
+ *
+ * The helper values are evaluated per block of voxels and combined in
+ * block order, so that they do not depend on the number of threads.
+ */
+CrossCorrelationEvaluationHelperValues evaluateHelperValues(DensitySimilarityMeasure::density reference,
+                                                            DensitySimilarityMeasure::density compared,
+                                                            int                               numThreads)
+{
+    const index numVoxels = reference.mapping().required_span_size();
+    const index numBlocks = numVoxelBlocks(numVoxels);
+    if (numBlocks == 1)
+    {
+        return evaluateHelperValues(reference.data(), compared.data(), numVoxels);
+    }
 
-        ++referenceIterator;
-        ++i;
+    const int numThreadsUsed = numThreadsForVoxelBlocks(numThreads, numBlocks);
+    std::vector<CrossCorrelationEvaluationHelperValues> blockHelperValues(numBlocks);
+#pragma omp parallel for num_threads(numThreadsUsed) schedule(static)
+    for (index block = 0; block < numBlocks; ++block)
+    {
+        const index begin = block * c_voxelsPerBlock;
+        const index end   = std::min(begin + c_voxelsPerBlock, numVoxels);
+        blockHelperValues[block] =
+                evaluateHelperValues(reference.data() + begin, compared.data() + begin, end - begin);
     }
 
+    // the combined values of the preceding blocks cover all voxels before begin
+    CrossCorrelationEvaluationHelperValues helperValues = blockHelperValues[0];
+    for (index block = 1; block < numBlocks; ++block)
+    {
+        const index begin = block * c_voxelsPerBlock;
+        const index end   = std::min(begin + c_voxelsPerBlock, numVoxels);
+        helperValues = combineHelperValues(helperValues, begin, blockHelperValues[block], end - begin);
+    }
     return helperValues;
 }
 
@@ -276,7 +423,7 @@ public:
     {
     }
     //! Evaluate the cross correlation gradient at a voxel
-    real operator()(real reference, real comparison)
+    real operator()(real reference, real comparison) const
     {
         return prefactor_
                * (reference - meanReference_ - comparisonPrefactor_ * (comparison - meanComparison_));
@@ -308,11 +455,11 @@ public:
     //! Construct similarity measure by setting the reference density
     DensitySimilarityCrossCorrelation(density referenceDensity);
     //! The gradient for the cross correlation similarity measure
-    density gradient(density comparedDensity) override;
+    density gradient(density comparedDensity, int numThreads) override;
     //! Clone this
     std::unique_ptr<DensitySimilarityMeasureImpl> clone() override;
     //! The similarity between reference density and compared density
-    real similarity(density comparedDensity) override;
+    real similarity(density comparedDensity, int numThreads) override;
 
 private:
     //! A view on the reference density
@@ -327,7 +474,7 @@ DensitySimilarityCrossCorrelation::DensitySimilarityCrossCorrelation(density ref
 {
 }
 
-real DensitySimilarityCrossCorrelation::similarity(density comparedDensity)
+real DensitySimilarityCrossCorrelation::similarity(density comparedDensity, int numThreads)
 {
     if (comparedDensity.extents() != referenceDensity_.extents())
     {
@@ -335,7 +482,7 @@ real DensitySimilarityCrossCorrelation::similarity(density comparedDensity)
     }
 
     CrossCorrelationEvaluationHelperValues helperValues =
-            evaluateHelperValues(referenceDensity_, comparedDensity);
+            evaluateHelperValues(referenceDensity_, comparedDensity, numThreads);
 
     if ((helperValues.referenceSquaredSum == 0) || (helperValues.comparisonSquaredSum == 0))
     {
@@ -351,7 +498,8 @@ real DensitySimilarityCrossCorrelation::similarity(density comparedDensity)
            * (covarianceSqrt / sqrt(helperValues.comparisonSquaredSum));
 }
 
-DensitySimilarityMeasure::density DensitySimilarityCrossCorrelation::gradient(density comparedDensity)
+DensitySimilarityMeasure::density DensitySimilarityCrossCorrelation::gradient(density comparedDensity,
+                                                                              int     numThreads)
 {
     if (comparedDensity.extents() != referenceDensity_.extents())
     {
@@ -359,10 +507,10 @@ DensitySimilarityMeasure::density DensitySimilarityCrossCorrelation::gradient(de
     }
 
     CrossCorrelationEvaluationHelperValues helperValues =
-            evaluateHelperValues(referenceDensity_, comparedDensity);
+            evaluateHelperValues(referenceDensity_, comparedDensity, numThreads);
 
-    std::transform(begin(referenceDensity_), end(referenceDensity_), begin(comparedDensity),
-                   begin(gradient_), CrossCorrelationGradientAtVoxel(helperValues));
+    transformVoxels(referenceDensity_, comparedDensity, gradient_.asView().data(), numThreads,
+                    CrossCorrelationGradientAtVoxel(helperValues));
 
     return gradient_.asConstView();
 }
@@ -398,24 +546,31 @@ DensitySimilarityMeasure::DensitySimilarityMeasure(DensitySimilarityMeasureMetho
 
 DensitySimilarityMeasure::density DensitySimilarityMeasure::gradient(density comparedDensity)
 {
-    return impl_->gradient(comparedDensity);
+    return impl_->gradient(comparedDensity, numThreads_);
 }
 
 real DensitySimilarityMeasure::similarity(density comparedDensity)
 {
-    return impl_->similarity(comparedDensity);
+    return impl_->similarity(comparedDensity, numThreads_);
+}
+
+void DensitySimilarityMeasure::setNumThreads(int numThreads)
+{
+    numThreads_ = numThreads;
 }
 
 DensitySimilarityMeasure::~DensitySimilarityMeasure() = default;
 
 DensitySimilarityMeasure::DensitySimilarityMeasure(const DensitySimilarityMeasure& other) :
-    impl_(other.impl_->clone())
+    impl_(other.impl_->clone()),
+    numThreads_(other.numThreads_)
 {
 }
 
 DensitySimilarityMeasure& DensitySimilarityMeasure::operator=(const DensitySimilarityMeasure& other)
 {
-    impl_ = other.impl_->clone();
+    impl_       = other.impl_->clone();
+    numThreads_ = other.numThreads_;
     return *this;
 }
 
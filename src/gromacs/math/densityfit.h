@@ -132,9 +132,15 @@ public:
      * \returns density similarity
      */
     real similarity(density comparedDensity);
+    /*! \brief Set the number of OpenMP threads used by gradient() and similarity().
+     * \param[in] numThreads number of OpenMP threads to use, one by default
+     */
+    void setNumThreads(int numThreads);
 
 private:
     std::unique_ptr<DensitySimilarityMeasureImpl> impl_;
+    //! Number of OpenMP threads to use
+    int numThreads_ = 1;
 };
 
 } // namespace gmx
@@ -94,7 +94,7 @@ real rmsdev_ind(int nind, int index[], real mass[], rvec x[], rvec xp[])
     return calc_similar_ind(FALSE, nind, index, mass, x, xp);
 }
 
-real rmsdev(int natoms, real mass[], rvec x[], rvec xp[])
+real rmsdev(int natoms, const real mass[], rvec x[], rvec xp[])
 {
     return calc_similar_ind(FALSE, natoms, nullptr, mass, x, xp);
 }
@@ -109,7 +109,188 @@ real rhodev(int natoms, real mass[], rvec x[], rvec xp[])
     return calc_similar_ind(TRUE, natoms, nullptr, mass, x, xp);
 }
 
-void calc_fit_R(int ndim, int natoms, const real* w_rls, const rvec* xp, rvec* x, matrix R)
+//! Returns the determinant of the 3x3 submatrix of \p a with rows \p r and columns \p c.
+static double det3_sub(const double a[4][4], const int r[3], const int c[3])
+{
+    return a[r[0]][c[0]] * (a[r[1]][c[1]] * a[r[2]][c[2]] - a[r[1]][c[2]] * a[r[2]][c[1]])
+           - a[r[0]][c[1]] * (a[r[1]][c[0]] * a[r[2]][c[2]] - a[r[1]][c[2]] * a[r[2]][c[0]])
+           + a[r[0]][c[2]] * (a[r[1]][c[0]] * a[r[2]][c[1]] - a[r[1]][c[1]] * a[r[2]][c[0]]);
+}
+
+/*! \brief Computes the 3D fit rotation with the quaternion characteristic polynomial method.
+ *
+ * The optimal rotation is given by the eigenvector of the largest
+ * eigenvalue of a symmetric 4x4 key matrix built from the correlation
+ * matrix, see Theobald, Acta Cryst. A61, 478 (2005) and Liu et al.,
+ * J. Comput. Chem. 31, 1561 (2010). The largest eigenvalue is found by
+ * Newton iteration on the characteristic polynomial, starting from its
+ * upper bound, and the eigenvector from the adjugate of the shifted key
+ * matrix. This avoids the Jacobi diagonalization of a 6x6 matrix.
+ *
+ * Returns false when the eigenvector is (close to) degenerate, for
+ * instance for linear structures, in which case R is not set.
+ */
+static bool calc_fit_R_qcp(int natoms, const real* w_rls, const rvec* xp, const rvec* x, matrix R)
+{
+    /* Correlation matrix S[i][j] = sum_n w_n x_n[i] xp_n[j] and inner products */
+    double S[DIM][DIM]  = { { 0 } };
+    double innerProduct = 0;
+    for (int n = 0; n < natoms; n++)
+    {
+        const double w = w_rls[n];
+        if (w != 0)
+        {
+            for (int i = 0; i < DIM; i++)
+            {
+                const double wx = w * x[n][i];
+                for (int j = 0; j < DIM; j++)
+                {
+                    S[i][j] += wx * xp[n][j];
+                }
+                innerProduct += wx * x[n][i] + w * xp[n][i] * xp[n][i];
+            }
+        }
+    }
+    /* Upper bound for the largest eigenvalue */
+    const double E0 = 0.5 * innerProduct;
+    if (!(E0 > 0))
+    {
+        return false;
+    }
+
+    const double Sxx = S[XX][XX], Sxy = S[XX][YY], Sxz = S[XX][ZZ];
+    const double Syx = S[YY][XX], Syy = S[YY][YY], Syz = S[YY][ZZ];
+    const double Szx = S[ZZ][XX], Szy = S[ZZ][YY], Szz = S[ZZ][ZZ];
+
+    /* The symmetric, traceless key matrix */
+    double K[4][4] = { { Sxx + Syy + Szz, Syz - Szy, Szx - Sxz, Sxy - Syx },
+                       { Syz - Szy, Sxx - Syy - Szz, Sxy + Syx, Szx + Sxz },
+                       { Szx - Sxz, Sxy + Syx, -Sxx + Syy - Szz, Syz + Szy },
+                       { Sxy - Syx, Szx + Sxz, Syz + Szy, -Sxx - Syy + Szz } };
+
+    /* Characteristic polynomial lambda^4 + c2 lambda^2 + c1 lambda + c0 */
+    double sumSquares = 0;
+    for (int i = 0; i < DIM; i++)
+    {
+        for (int j = 0; j < DIM; j++)
+        {
+            sumSquares += S[i][j] * S[i][j];
+        }
+    }
+    const double c2   = -2 * sumSquares;
+    const double detS = Sxx * (Syy * Szz - Syz * Szy) - Sxy * (Syx * Szz - Syz * Szx)
+                        + Sxz * (Syx * Szy - Syy * Szx);
+    const double c1 = -8 * detS;
+    double       c0 = 0;
+    {
+        const int rows[3] = { 1, 2, 3 };
+        for (int c = 0; c < 4; c++)
+        {
+            int cols[3], nc = 0;
+            for (int j = 0; j < 4; j++)
+            {
+                if (j != c)
+                {
+                    cols[nc++] = j;
+                }
+            }
+            c0 += ((c % 2 == 0) ? 1 : -1) * K[0][c] * det3_sub(K, rows, cols);
+        }
+    }
+
+    /* Newton iteration for the largest root, converges monotonically from E0 */
+    const double c_evalPrecision = 1e-11;
+    double       lambda          = E0;
+    for (int iter = 0; iter < 50; iter++)
+    {
+        const double lambda2 = lambda * lambda;
+        const double poly    = (lambda2 + c2) * lambda2 + c1 * lambda + c0;
+        const double dpoly   = 4 * lambda2 * lambda + 2 * c2 * lambda + c1;
+        if (dpoly == 0)
+        {
+            break;
+        }
+        const double delta = poly / dpoly;
+        lambda -= delta;
+        if (std::fabs(delta) < c_evalPrecision * std::fabs(lambda))
+        {
+            break;
+        }
+    }
+
+    /* The eigenvector is any non-zero column of the adjugate of K - lambda I,
+     * which are the rows of its cofactor matrix. Use the largest one.
+     */
+    for (int i = 0; i < 4; i++)
+    {
+        K[i][i] -= lambda;
+    }
+    double q[4]   = { 0 };
+    double qNorm2 = 0;
+    for (int r = 0; r < 4; r++)
+    {
+        int rows[3], nr = 0;
+        for (int i = 0; i < 4; i++)
+        {
+            if (i != r)
+            {
+                rows[nr++] = i;
+            }
+        }
+        double cof[4], norm2 = 0;
+        for (int c = 0; c < 4; c++)
+        {
+            int cols[3], nc = 0;
+            for (int j = 0; j < 4; j++)
+            {
+                if (j != c)
+                {
+                    cols[nc++] = j;
+                }
+            }
+            cof[c] = (((r + c) % 2 == 0) ? 1 : -1) * det3_sub(K, rows, cols);
+            norm2 += cof[c] * cof[c];
+        }
+        if (norm2 > qNorm2)
+        {
+            qNorm2 = norm2;
+            for (int c = 0; c < 4; c++)
+            {
+                q[c] = cof[c];
+            }
+        }
+    }
+    /* The cofactors scale with the cube of the matrix elements */
+    const double c_evecPrecision = 1e-6;
+    const double scale3          = E0 * E0 * E0;
+    if (qNorm2 <= gmx::square(c_evecPrecision * scale3))
+    {
+        return false;
+    }
+    const double invNorm = 1 / std::sqrt(qNorm2);
+    for (int c = 0; c < 4; c++)
+    {
+        q[c] *= invNorm;
+    }
+
+    /* Rotation matrix from the unit quaternion */
+    const double q00 = q[0] * q[0], q11 = q[1] * q[1], q22 = q[2] * q[2], q33 = q[3] * q[3];
+    const double q01 = q[0] * q[1], q02 = q[0] * q[2], q03 = q[0] * q[3];
+    const double q12 = q[1] * q[2], q13 = q[1] * q[3], q23 = q[2] * q[3];
+    R[XX][XX] = q00 + q11 - q22 - q33;
+    R[XX][YY] = 2 * (q12 - q03);
+    R[XX][ZZ] = 2 * (q13 + q02);
+    R[YY][XX] = 2 * (q12 + q03);
+    R[YY][YY] = q00 - q11 + q22 - q33;
+    R[YY][ZZ] = 2 * (q23 - q01);
+    R[ZZ][XX] = 2 * (q13 - q02);
+    R[ZZ][YY] = 2 * (q23 + q01);
+    R[ZZ][ZZ] = q00 - q11 - q22 + q33;
+
+    return true;
+}
+
+void calc_fit_R_jacobi(int ndim, int natoms, const real* w_rls, const rvec* xp, rvec* x, matrix R)
 {
     int      c, r, n, j, i, irot, s;
     double **omega, **om;
@@ -258,7 +439,17 @@ void calc_fit_R(int ndim, int natoms, const real* w_rls, const rvec* xp, rvec* x
     sfree(om);
 }
 
-void do_fit_ndim(int ndim, int natoms, real* w_rls, const rvec* xp, rvec* x)
+void calc_fit_R(int ndim, int natoms, const real* w_rls, const rvec* xp, rvec* x, matrix R)
+{
+    if (ndim == 3 && calc_fit_R_qcp(natoms, w_rls, xp, x, R))
+    {
+        return;
+    }
+
+    calc_fit_R_jacobi(ndim, natoms, w_rls, xp, x, R);
+}
+
+void do_fit_ndim(int ndim, int natoms, const real* w_rls, const rvec* xp, rvec* x)
 {
     int    j, m, r, c;
     matrix R;
@@ -285,7 +476,7 @@ void do_fit_ndim(int ndim, int natoms, real* w_rls, const rvec* xp, rvec* x)
     }
 }
 
-void do_fit(int natoms, real* w_rls, const rvec* xp, rvec* x)
+void do_fit(int natoms, const real* w_rls, const rvec* xp, rvec* x)
 {
     do_fit_ndim(3, natoms, w_rls, xp, x);
 }
@@ -47,7 +47,7 @@ real calc_similar_ind(gmx_bool bRho, int nind, const int* index, const real mass
 real rmsdev_ind(int nind, int index[], real mass[], rvec x[], rvec xp[]);
 /* Returns the RMS Deviation betweem x and xp over all atoms in index */
 
-real rmsdev(int natoms, real mass[], rvec x[], rvec xp[]);
+real rmsdev(int natoms, const real mass[], rvec x[], rvec xp[]);
 /* Returns the RMS Deviation betweem x and xp over all atoms */
 
 real rhodev_ind(int nind, int index[], real mass[], rvec x[], rvec xp[]);
@@ -66,9 +66,17 @@ void calc_fit_R(int ndim, int natoms, const real* w_rls, const rvec* xp, rvec* x
  * is minimal. ndim=3 gives full fit, ndim=2 gives xy fit.
  * This matrix is also used do_fit.
  * x_rotated[i] = sum R[i][j]*x[j]
+ * For ndim=3 the quaternion characteristic polynomial method is used,
+ * with a fall-back to diagonalization for degenerate structures.
  */
 
-void do_fit_ndim(int ndim, int natoms, real* w_rls, const rvec* xp, rvec* x);
+void calc_fit_R_jacobi(int ndim, int natoms, const real* w_rls, const rvec* xp, rvec* x, matrix R);
+/* As calc_fit_R, but always computes R by Jacobi diagonalization of a
+ * 2*ndim x 2*ndim matrix. This is the fall-back of calc_fit_R for
+ * degenerate structures, it is exposed for testing.
+ */
+
+void do_fit_ndim(int ndim, int natoms, const real* w_rls, const rvec* xp, rvec* x);
 /* Do a least squares fit of x to xp. Atoms which have zero mass
  * (w_rls[i]) are not taken into account in fitting.
  * This makes is possible to fit eg. on Calpha atoms and orient
@@ -76,7 +84,7 @@ void do_fit_ndim(int ndim, int natoms, real* w_rls, const rvec* xp, rvec* x);
  * therefore both xp and x should be centered round the origin.
  */
 
-void do_fit(int natoms, real* w_rls, const rvec* xp, rvec* x);
+void do_fit(int natoms, const real* w_rls, const rvec* xp, rvec* x);
 /* Calls do_fit with ndim=3, thus fitting in 3D */
 
 void reset_x_ndim(int ndim, int ncm, const int* ind_cm, int nreset, const int* ind_reset, rvec x[], const real mass[]);
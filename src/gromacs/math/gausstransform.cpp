@@ -52,6 +52,9 @@
 #include "gromacs/math/functions.h"
 #include "gromacs/math/multidimarray.h"
 #include "gromacs/math/utilities.h"
+#include "gromacs/utility/exceptions.h"
+#include "gromacs/utility/gmxassert.h"
+#include "gromacs/utility/gmxomp.h"
 
 namespace gmx
 {
@@ -317,6 +320,18 @@ public:
     Impl& operator=(const Impl& other) = default;
     //! Add another gaussian
     void add(const GaussianSpreadKernelParameters::PositionAndAmplitude& localParamters);
+    /*! \brief Add the part of a gaussian that lies within a range of the slowest lattice index
+     * \param[in] localParameters of the spreading kernel
+     * \param[in] zBegin first lattice index in the slowest varying dimension to spread to
+     * \param[in] zEnd one beyond the last lattice index in the slowest varying dimension
+     * \param[in] gauss1d scratch for the one-dimensional Gaussians
+     * \param[in] outerProductZY scratch for the outer product of the z and y Gaussians
+     */
+    void addWithinRange(const GaussianSpreadKernelParameters::PositionAndAmplitude& localParameters,
+                        int                                                         zBegin,
+                        int                                                         zEnd,
+                        std::array<GaussianOn1DLattice, DIM>*                       gauss1d,
+                        OuterProductEvaluator*                                      outerProductZY);
     //! The width of the Gaussian in lattice spacing units
     BasicVector<double> sigma_;
     //! The spread range in lattice points
@@ -341,6 +356,15 @@ GaussTransform3D::Impl::Impl(const dynamicExtents3D&                      extent
 }
 
 void GaussTransform3D::Impl::add(const GaussianSpreadKernelParameters::PositionAndAmplitude& localParameters)
+{
+    addWithinRange(localParameters, 0, data_.asView().extent(0), &gauss1d_, &outerProductZY_);
+}
+
+void GaussTransform3D::Impl::addWithinRange(const GaussianSpreadKernelParameters::PositionAndAmplitude& localParameters,
+                                            int                                   zBegin,
+                                            int                                   zEnd,
+                                            std::array<GaussianOn1DLattice, DIM>* gauss1d,
+                                            OuterProductEvaluator*                outerProductZY)
 {
     const IVec closestLatticePoint = closestIntegerPoint(localParameters.coordinate_);
     const auto spreadRange =
@@ -352,29 +376,39 @@ void GaussTransform3D::Impl::add(const GaussianSpreadKernelParameters::PositionA
         return;
     }
 
+    // do nothing if the added Gaussian does not reach the requested range
+    const int zSpreadBegin = std::max(spreadRange.begin()[ZZ], zBegin);
+    const int zSpreadEnd   = std::min(spreadRange.end()[ZZ], zEnd);
+    if (zSpreadBegin >= zSpreadEnd)
+    {
+        return;
+    }
+
     for (int dimension = XX; dimension <= ZZ; ++dimension)
     {
         // multiply with amplitude so that Gauss3D = (amplitude * Gauss_x) * Gauss_y * Gauss_z
         const float gauss1DAmplitude = dimension > XX ? 1.0 : localParameters.amplitude_;
-        gauss1d_[dimension].spread(gauss1DAmplitude, localParameters.coordinate_[dimension]
-                                                             - closestLatticePoint[dimension]);
+        (*gauss1d)[dimension].spread(gauss1DAmplitude, localParameters.coordinate_[dimension]
+                                                               - closestLatticePoint[dimension]);
     }
 
-    const auto spreadZY         = outerProductZY_(gauss1d_[ZZ].view(), gauss1d_[YY].view());
-    const auto spreadX          = gauss1d_[XX].view();
     const IVec spreadGridOffset = spreadRange_ - closestLatticePoint;
+    // only evaluate the outer product for the part of the z-range that is spread to
+    const auto spreadZ = (*gauss1d)[ZZ].view().subArray(zSpreadBegin + spreadGridOffset[ZZ],
+                                                        zSpreadEnd - zSpreadBegin);
+    const auto spreadZY = (*outerProductZY)(spreadZ, (*gauss1d)[YY].view());
+    const auto spreadX  = (*gauss1d)[XX].view();
 
-    // \todo optimize these loops if performance critical
     // The looping strategy uses that the last, x-dimension is contiguous in the memory layout
-    for (int zLatticeIndex = spreadRange.begin()[ZZ]; zLatticeIndex < spreadRange.end()[ZZ]; ++zLatticeIndex)
+    for (int zLatticeIndex = zSpreadBegin; zLatticeIndex < zSpreadEnd; ++zLatticeIndex)
     {
         const auto zSlice = data_.asView()[zLatticeIndex];
 
         for (int yLatticeIndex = spreadRange.begin()[YY]; yLatticeIndex < spreadRange.end()[YY]; ++yLatticeIndex)
         {
             const auto  ySlice      = zSlice[yLatticeIndex];
-            const float zyPrefactor = spreadZY(zLatticeIndex + spreadGridOffset[ZZ],
-                                               yLatticeIndex + spreadGridOffset[YY]);
+            const float zyPrefactor =
+                    spreadZY(zLatticeIndex - zSpreadBegin, yLatticeIndex + spreadGridOffset[YY]);
 
             for (int xLatticeIndex = spreadRange.begin()[XX]; xLatticeIndex < spreadRange.end()[XX];
                  ++xLatticeIndex)
@@ -401,6 +435,40 @@ void GaussTransform3D::add(const GaussianSpreadKernelParameters::PositionAndAmpl
     impl_->add(localParameters);
 }
 
+void GaussTransform3D::add(ArrayRef<const RVec> coordinates, ArrayRef<const real> amplitudes, int numThreads)
+{
+    GMX_ASSERT(coordinates.size() == amplitudes.size(),
+               "Need as many amplitudes as coordinates to spread");
+    const int zExtent = impl_->data_.asView().extent(0);
+    if (numThreads <= 1 || zExtent < numThreads)
+    {
+        for (index i = 0; i < coordinates.ssize(); ++i)
+        {
+            impl_->add({ coordinates[i], amplitudes[i] });
+        }
+        return;
+    }
+
+#pragma omp parallel num_threads(numThreads)
+    {
+        try
+        {
+            // Each thread owns a slab of the lattice and needs its own scratch
+            const int                            thread = gmx_omp_get_thread_num();
+            const int                            zBegin = (zExtent * thread) / numThreads;
+            const int                            zEnd   = (zExtent * (thread + 1)) / numThreads;
+            std::array<GaussianOn1DLattice, DIM> gauss1d(impl_->gauss1d_);
+            OuterProductEvaluator                outerProductZY;
+            for (index i = 0; i < coordinates.ssize(); ++i)
+            {
+                impl_->addWithinRange({ coordinates[i], amplitudes[i] }, zBegin, zEnd, &gauss1d,
+                                      &outerProductZY);
+            }
+        }
+        GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR
+    }
+}
+
 void GaussTransform3D::setZero()
 {
     std::fill(begin(impl_->data_), end(impl_->data_), 0.);
@@ -193,6 +193,19 @@ public:
      */
     void add(const GaussianSpreadKernelParameters::PositionAndAmplitude& localParameters);
 
+    /*! \brief Add three dimensional Gaussians with given amplitudes at coordinates.
+     *
+     * The lattice is split into slabs along its slowest varying dimension,
+     * one per thread. Each thread adds the parts of all Gaussians that
+     * reach its slab, so the result is identical to calling add() for each
+     * Gaussian in order.
+     *
+     * \param[in] coordinates of the Gaussians in lattice coordinates
+     * \param[in] amplitudes of the Gaussians
+     * \param[in] numThreads number of OpenMP threads to use
+     */
+    void add(ArrayRef<const RVec> coordinates, ArrayRef<const real> amplitudes, int numThreads);
+
     //! \brief Set all values on the lattice to zero.
     void setZero();
 
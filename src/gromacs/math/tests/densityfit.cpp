@@ -43,6 +43,7 @@
 
 #include "gromacs/math/densityfit.h"
 
+#include <cmath>
 #include <numeric>
 
 #include <gtest/gtest.h>
@@ -287,6 +288,44 @@ TEST(DensitySimilarityTest, CrossCorrelationGradientIsCorrect)
     checker.checkSequence(gradientView.begin(), gradientView.end(), "cross-correlation-gradient");
 }
 
+TEST(DensitySimilarityTest, SimilarityDoesNotDependOnNumberOfThreads)
+{
+    MultiDimArray<std::vector<float>, dynamicExtents3D> referenceDensity(60, 60, 60);
+    std::iota(begin(referenceDensity), end(referenceDensity), 1);
+
+    MultiDimArray<std::vector<float>, dynamicExtents3D> comparedDensity(60, 60, 60);
+    std::iota(begin(comparedDensity), end(comparedDensity), 2);
+    // some non-linear transformation, so that the sums are not trivial
+    for (float& valueToCompare : comparedDensity)
+    {
+        valueToCompare = std::sqrt(valueToCompare);
+    }
+
+    for (const auto method : { DensitySimilarityMeasureMethod::innerProduct,
+                               DensitySimilarityMeasureMethod::relativeEntropy,
+                               DensitySimilarityMeasureMethod::crossCorrelation })
+    {
+        DensitySimilarityMeasure measure(method, referenceDensity.asConstView());
+
+        measure.setNumThreads(1);
+        const real similarityOneThread = measure.similarity(comparedDensity.asConstView());
+        // copy the gradient, because the measure overwrites it when evaluated again
+        const basic_mdspan<const float, dynamicExtents3D> gradient =
+                measure.gradient(comparedDensity.asConstView());
+        const std::vector<float> gradientOneThread(
+                gradient.data(), gradient.data() + gradient.mapping().required_span_size());
+
+        measure.setNumThreads(3);
+        const real similarityThreeThreads = measure.similarity(comparedDensity.asConstView());
+        measure.gradient(comparedDensity.asConstView());
+        ArrayRef<const float> gradientThreeThreads(
+                gradient.data(), gradient.data() + gradient.mapping().required_span_size());
+
+        EXPECT_EQ(similarityOneThread, similarityThreeThreads);
+        EXPECT_THAT(gradientOneThread, testing::Pointwise(testing::Eq(), gradientThreeThreads));
+    }
+}
+
 } // namespace test
 
 } // namespace gmx
@@ -42,11 +42,15 @@
 #include "gmxpre.h"
 
 #include <array>
+#include <cmath>
+#include <vector>
 
 #include <gtest/gtest.h>
 
 #include "gromacs/math/do_fit.h"
 #include "gromacs/math/vec.h"
+#include "gromacs/random/threefry.h"
+#include "gromacs/random/uniformrealdistribution.h"
 
 #include "testutils/testasserts.h"
 
@@ -99,4 +103,262 @@ TEST_F(StructureSimilarityTest, YieldsCorrectRhoWidthIndex)
     EXPECT_REAL_EQ_TOL(2., rhodev_ind(index_.size(), index_.data(), m_, x1_, x2_), defaultRealTolerance());
 }
 
+class FitTest : public ::testing::Test
+{
+protected:
+    static constexpr int       c_nAtoms = 5;
+    std::array<RVec, c_nAtoms> reference_{
+        { { 0.1, -0.3, 0.2 }, { 1.2, 0.4, -0.5 }, { -0.7, 0.9, 0.3 }, { 0.4, -1.1, 0.8 }, { -1.0, 0.1, -0.8 } }
+    };
+    std::array<real, c_nAtoms> masses_{ { 1, 2, 1, 3, 1 } };
+
+    //! Returns the reference rotated around the axis (1,1,1)/sqrt(3) by \p angle.
+    std::array<RVec, c_nAtoms> rotatedReference(real angle) const
+    {
+        matrix R;
+        const real c = std::cos(angle), s = std::sin(angle), t = 1 - c;
+        const real u = 1 / std::sqrt(3.0);
+        for (int i = 0; i < DIM; i++)
+        {
+            for (int j = 0; j < DIM; j++)
+            {
+                R[i][j] = t * u * u + (i == j ? c : 0);
+            }
+        }
+        R[XX][YY] -= s * u;
+        R[YY][XX] += s * u;
+        R[XX][ZZ] += s * u;
+        R[ZZ][XX] -= s * u;
+        R[YY][ZZ] -= s * u;
+        R[ZZ][YY] += s * u;
+        std::array<RVec, c_nAtoms> rotated;
+        for (int i = 0; i < c_nAtoms; i++)
+        {
+            mvmul(R, reference_[i], rotated[i]);
+        }
+        return rotated;
+    }
+};
+
+TEST_F(FitTest, FitUndoesRotation)
+{
+    for (real angle : { 0.0, 0.5, 2.0, 3.1 })
+    {
+        auto x = rotatedReference(angle);
+        do_fit(c_nAtoms, masses_.data(), gmx::as_rvec_array(reference_.data()),
+               gmx::as_rvec_array(x.data()));
+        for (int i = 0; i < c_nAtoms; i++)
+        {
+            for (int d = 0; d < DIM; d++)
+            {
+                EXPECT_REAL_EQ_TOL(reference_[i][d], x[i][d], gmx::test::absoluteTolerance(1e-5));
+            }
+        }
+    }
+}
+
+TEST_F(FitTest, FitOfPlanarStructureIsProperRotation)
+{
+    for (auto& x : reference_)
+    {
+        x[ZZ] = 0;
+    }
+    auto   x = rotatedReference(1.0);
+    matrix R;
+    calc_fit_R(3, c_nAtoms, masses_.data(), gmx::as_rvec_array(reference_.data()),
+               gmx::as_rvec_array(x.data()), R);
+    EXPECT_REAL_EQ_TOL(1.0, det(R), gmx::test::absoluteTolerance(1e-5));
+}
+
+TEST_F(FitTest, FitMinimizesDeviationForDifferentStructures)
+{
+    auto x = rotatedReference(0.7);
+    x[2][XX] += 0.3;
+    x[4][YY] -= 0.2;
+    const real rmsdBefore = rmsdev(c_nAtoms, masses_.data(), gmx::as_rvec_array(reference_.data()),
+                                   gmx::as_rvec_array(x.data()));
+    do_fit(c_nAtoms, masses_.data(), gmx::as_rvec_array(reference_.data()), gmx::as_rvec_array(x.data()));
+    const real rmsdFitted = rmsdev(c_nAtoms, masses_.data(), gmx::as_rvec_array(reference_.data()),
+                                   gmx::as_rvec_array(x.data()));
+    EXPECT_LT(rmsdFitted, rmsdBefore);
+    /* Small rotations around the fit should not decrease the deviation */
+    for (real angle : { -0.01, 0.01 })
+    {
+        std::array<RVec, c_nAtoms> perturbed;
+        const real                 c = std::cos(angle), s = std::sin(angle);
+        for (int i = 0; i < c_nAtoms; i++)
+        {
+            perturbed[i] = { c * x[i][XX] - s * x[i][YY], s * x[i][XX] + c * x[i][YY], x[i][ZZ] };
+        }
+        EXPECT_GE(rmsdev(c_nAtoms, masses_.data(), gmx::as_rvec_array(reference_.data()),
+                         gmx::as_rvec_array(perturbed.data())),
+                  rmsdFitted);
+    }
+}
+
+/*! \brief Compares the quaternion fit of calc_fit_R with the Jacobi diagonalization.
+ *
+ * The structures are centered, as they are in do_fit.
+ */
+class FitMethodTest : public ::testing::Test
+{
+protected:
+    static constexpr int c_nAtoms = 20;
+
+    FitMethodTest() : rng_(12345, gmx::RandomDomain::Other), masses_(c_nAtoms)
+    {
+        gmx::UniformRealDistribution<real> dist(0.5, 2);
+        for (real& m : masses_)
+        {
+            m = dist(rng_);
+        }
+    }
+
+    //! Returns random coordinates with components up to \p scale[d] in absolute value.
+    std::vector<RVec> randomStructure(const RVec& scale)
+    {
+        gmx::UniformRealDistribution<real> dist(-1, 1);
+        std::vector<RVec>                  x(c_nAtoms);
+        for (RVec& v : x)
+        {
+            for (int d = 0; d < DIM; d++)
+            {
+                v[d] = scale[d] * dist(rng_);
+            }
+        }
+        return x;
+    }
+
+    //! Returns \p x rotated by \p angle around \p axis and displaced randomly by up to \p noise.
+    std::vector<RVec> rotatedCopy(const std::vector<RVec>& x, RVec axis, real angle, real noise)
+    {
+        gmx::UniformRealDistribution<real> dist(-1, 1);
+        unitv(axis, axis);
+        const real c = std::cos(angle), s = std::sin(angle), t = 1 - c;
+        matrix     R;
+        for (int i = 0; i < DIM; i++)
+        {
+            for (int j = 0; j < DIM; j++)
+            {
+                R[i][j] = t * axis[i] * axis[j] + (i == j ? c : 0);
+            }
+        }
+        R[XX][YY] -= s * axis[ZZ];
+        R[YY][XX] += s * axis[ZZ];
+        R[XX][ZZ] += s * axis[YY];
+        R[ZZ][XX] -= s * axis[YY];
+        R[YY][ZZ] -= s * axis[XX];
+        R[ZZ][YY] += s * axis[XX];
+        std::vector<RVec> rotated(x.size());
+        for (size_t i = 0; i < x.size(); i++)
+        {
+            mvmul(R, x[i], rotated[i]);
+            for (int d = 0; d < DIM; d++)
+            {
+                rotated[i][d] += noise * dist(rng_);
+            }
+        }
+        return rotated;
+    }
+
+    //! Centers \p x on its center of mass.
+    void center(std::vector<RVec>* x)
+    {
+        reset_x(c_nAtoms, nullptr, c_nAtoms, nullptr, gmx::as_rvec_array(x->data()), masses_.data());
+    }
+
+    //! Returns the RMSD of \p x to \p reference after rotating \p x by \p R.
+    real rmsdAfterRotation(std::vector<RVec> reference, const std::vector<RVec>& x, const matrix R)
+    {
+        std::vector<RVec> rotated(x.size());
+        for (size_t i = 0; i < x.size(); i++)
+        {
+            mvmul(R, x[i], rotated[i]);
+        }
+        return rmsdev(c_nAtoms, masses_.data(), gmx::as_rvec_array(reference.data()),
+                      gmx::as_rvec_array(rotated.data()));
+    }
+
+    /*! \brief Fits \p x to \p reference with both methods and compares the results.
+     *
+     * Both rotations should be proper and give the same deviation. With
+     * \p compareRotations, the rotation matrices should also agree,
+     * which only holds when the optimal rotation is unique.
+     */
+    void compareMethods(std::vector<RVec> reference, std::vector<RVec> x, bool compareRotations)
+    {
+        center(&reference);
+        center(&x);
+        matrix Rqcp, Rjacobi;
+        calc_fit_R(3, c_nAtoms, masses_.data(), gmx::as_rvec_array(reference.data()),
+                   gmx::as_rvec_array(x.data()), Rqcp);
+        calc_fit_R_jacobi(3, c_nAtoms, masses_.data(), gmx::as_rvec_array(reference.data()),
+                          gmx::as_rvec_array(x.data()), Rjacobi);
+
+        const auto tolerance = gmx::test::absoluteTolerance(1e-4);
+        EXPECT_REAL_EQ_TOL(1.0, det(Rqcp), tolerance);
+        EXPECT_REAL_EQ_TOL(1.0, det(Rjacobi), tolerance);
+        EXPECT_REAL_EQ_TOL(rmsdAfterRotation(reference, x, Rjacobi),
+                           rmsdAfterRotation(reference, x, Rqcp), tolerance);
+        if (compareRotations)
+        {
+            for (int i = 0; i < DIM; i++)
+            {
+                for (int j = 0; j < DIM; j++)
+                {
+                    EXPECT_REAL_EQ_TOL(Rjacobi[i][j], Rqcp[i][j], tolerance);
+                }
+            }
+        }
+    }
+
+    gmx::DefaultRandomEngine rng_;
+    std::vector<real>        masses_;
+};
+
+TEST_F(FitMethodTest, AgreesForRandomStructures)
+{
+    for (int trial = 0; trial < 10; trial++)
+    {
+        const auto reference = randomStructure({ 1, 1, 1 });
+        const auto x         = rotatedCopy(reference, { 1, real(2 - trial), 0.5 }, 0.3 * trial, 0.1);
+        compareMethods(reference, x, true);
+    }
+}
+
+TEST_F(FitMethodTest, AgreesForPlanarStructures)
+{
+    for (int trial = 0; trial < 5; trial++)
+    {
+        const auto reference = randomStructure({ 1, 1, 0 });
+        const auto x         = rotatedCopy(reference, { 0.2, -0.4, 1 }, 0.6 * trial, 0.05);
+        compareMethods(reference, x, true);
+    }
+}
+
+TEST_F(FitMethodTest, AgreesForNearlyLinearStructures)
+{
+    for (int trial = 0; trial < 5; trial++)
+    {
+        const auto reference = randomStructure({ 1, 1e-4, 1e-4 });
+        const auto x         = rotatedCopy(reference, { 0, 1, 1 }, 0.5 * trial, 1e-4);
+        /* The rotation around the long axis is (nearly) undetermined */
+        compareMethods(reference, x, false);
+    }
+}
+
+TEST_F(FitMethodTest, AgreesForReflectedStructures)
+{
+    for (int trial = 0; trial < 5; trial++)
+    {
+        const auto reference = randomStructure({ 1, 1, 1 });
+        auto       x         = rotatedCopy(reference, { 1, -1, 0.3 }, 0.4 * trial, 0);
+        for (RVec& v : x)
+        {
+            v[XX] = -v[XX];
+        }
+        compareMethods(reference, x, false);
+    }
+}
+
 } // namespace
@@ -255,6 +255,29 @@ TEST_F(GaussTransformTest, centerGaussianInCubeHasExpectedValues)
     EXPECT_THAT(expectedValues, testing::Pointwise(FloatEq(tolerance_), gaussTransformVector));
 }
 
+TEST_F(GaussTransformTest, addingManyInParallelMatchesAddingOneByOne)
+{
+    const std::vector<RVec> coordinates = { latticeCenter_, { 0.2, 1.7, 0.4 }, { 2.1, 0.3, 2.6 } };
+    const std::vector<real> amplitudes  = { 1., -0.5, 2. };
+    for (size_t i = 0; i < coordinates.size(); ++i)
+    {
+        gaussTransform_.add({ coordinates[i], amplitudes[i] });
+    }
+
+    GaussTransform3D parallelGaussTransform = { latticeExtent_, { sigma_, nSigma_ } };
+    parallelGaussTransform.add(coordinates, amplitudes, 3);
+
+    std::vector<float> expectedValues;
+    expectedValues.assign(gaussTransform_.constView().data(),
+                          gaussTransform_.constView().data()
+                                  + gaussTransform_.constView().mapping().required_span_size());
+    std::vector<float> parallelValues;
+    parallelValues.assign(parallelGaussTransform.constView().data(),
+                          parallelGaussTransform.constView().data()
+                                  + parallelGaussTransform.constView().mapping().required_span_size());
+    EXPECT_THAT(expectedValues, testing::Pointwise(FloatEq(tolerance_), parallelValues));
+}
+
 TEST_F(GaussTransformTest, view)
 {
     gaussTransform_.add({ latticeCenter_, 1. });
@@ -270,6 +270,8 @@ EnergyOutput::EnergyOutput(ener_file*               fp_ene,
     bPres_          = !isRerun;
 
     ebin_ = mk_ebin();
+    snew(enxFrame_, 1);
+    init_enxframe(enxFrame_);
     /* Pass NULL for unit to let get_ebin_space determine the units
      * for interaction_function[i].longname
      */
@@ -579,6 +581,8 @@ EnergyOutput::~EnergyOutput()
     sfree(tmp_r_);
     sfree(tmp_v_);
     done_ebin(ebin_);
+    free_enxframe(enxFrame_);
+    sfree(enxFrame_);
     done_mde_delta_h_coll(dhc_);
     sfree(dE_);
     if (numTemperatures_ > 0)
@@ -1166,16 +1170,15 @@ void EnergyOutput::printStepToEnergyFile(ener_file* fp_ene,
                                          t_fcdata*  fcd,
                                          gmx::Awh*  awh)
 {
-    t_enxframe fr;
-    init_enxframe(&fr);
-    fr.t       = time;
-    fr.step    = step;
-    fr.nsteps  = ebin_->nsteps;
-    fr.dt      = delta_t_;
-    fr.nsum    = ebin_->nsum;
-    fr.nre     = (bEne) ? ebin_->nener : 0;
-    fr.ener    = ebin_->e;
-    int ndisre = bDR ? fcd->disres.npair : 0;
+    t_enxframe& fr = *enxFrame_;
+    fr.t           = time;
+    fr.step        = step;
+    fr.nsteps      = ebin_->nsteps;
+    fr.dt          = delta_t_;
+    fr.nsum        = ebin_->nsum;
+    fr.nre         = (bEne) ? ebin_->nener : 0;
+    fr.ener        = ebin_->e;
+    int ndisre     = bDR ? fcd->disres.npair : 0;
     /* these are for the old-style blocks (1 subblock, only reals), because
        there can be only one per ID for these */
     int   nr[enxNR];
@@ -1279,7 +1282,6 @@ void EnergyOutput::printStepToEnergyFile(ener_file* fp_ene,
             reset_ebin_sums(ebin_);
         }
     }
-    free_enxframe(&fr);
     if (log)
     {
         if (bOR && fcd->orires.nr > 0)
@@ -58,6 +58,7 @@ struct gmx_mtop_t;
 struct gmx_output_env_t;
 struct pull_t;
 struct t_ebin;
+struct t_enxframe;
 struct t_expanded;
 struct t_fcdata;
 struct t_grpopts;
@@ -264,6 +265,8 @@ private:
 
     //! Structure to store energy components and their running averages
     t_ebin* ebin_ = nullptr;
+    //! Energy file frame, reused for every frame written to avoid reallocating its blocks
+    t_enxframe* enxFrame_ = nullptr;
 
     //! Is the periodic box triclinic
     bool bTricl_ = false;
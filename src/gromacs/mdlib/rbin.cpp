@@ -136,13 +136,11 @@ int add_bind(t_bin* b, int nr, const double r[])
 
 void sum_bin(t_bin* b, const t_commrec* cr)
 {
-    int i;
-
-    for (i = b->nreal; (i < b->maxreal); i++)
-    {
-        b->rbuf[i] = 0;
-    }
-    gmx_sumd(b->maxreal, b->rbuf, cr);
+    /* Only the entries added since the last reset are communicated,
+     * the buffer can be much larger when it was filled with energies
+     * at an earlier step.
+     */
+    gmx_sumd(b->nreal, b->rbuf, cr);
 }
 
 void extract_binr(t_bin* b, int index, int nr, real r[])
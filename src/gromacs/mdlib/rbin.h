@@ -64,7 +64,7 @@ int add_bind(t_bin* b, int nr, const double r[]);
 /* Add reals to the bin. Returns index */
 
 void sum_bin(t_bin* b, const t_commrec* cr);
-/* Globally sum the reals in the bin */
+/* Globally sum the reals added to the bin since the last reset */
 
 void extract_binr(t_bin* b, int index, int nr, real r[]);
 void extract_binr(t_bin* b, int index, gmx::ArrayRef<real> r);
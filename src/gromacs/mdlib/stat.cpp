@@ -292,7 +292,7 @@ void global_stat(const gmx_global_stat*  gs,
     /* Global sum it all */
     if (debug)
     {
-        fprintf(debug, "Summing %d energies\n", rb->maxreal);
+        fprintf(debug, "Summing %d energies\n", rb->nreal);
     }
     sum_bin(rb, cr);
 
@@ -820,7 +820,11 @@ int Mdrunner::mdrunner()
     if (PAR(cr))
     {
         /* now broadcast everything to the non-master nodes/threads: */
-        if (!isSimulationMasterRank)
+        if (isSimulationMasterRank)
+        {
+            prepareTpxBodyForCommunication(partialDeserializedTpr.get(), *globalState, inputrec, &mtop);
+        }
+        else
         {
             inputrec = &inputrecInstance;
         }
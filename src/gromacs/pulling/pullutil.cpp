@@ -41,6 +41,8 @@
 #include <cassert>
 #include <cstdlib>
 
+#include <algorithm>
+
 #include "gromacs/fileio/confio.h"
 #include "gromacs/gmxlib/network.h"
 #include "gromacs/math/functions.h"
@@ -53,6 +55,7 @@
 #include "gromacs/mdtypes/state.h"
 #include "gromacs/pbcutil/pbc.h"
 #include "gromacs/pulling/pull.h"
+#include "gromacs/utility/exceptions.h"
 #include "gromacs/utility/fatalerror.h"
 #include "gromacs/utility/futil.h"
 #include "gromacs/utility/gmxassert.h"
@@ -516,6 +519,99 @@ static void sum_com_part_cosweight(const pull_group_work_t* pgrp,
     sum_com->sum_smp = sum_smp;
 }
 
+/*! \brief Computes the local COM sums of a group without cosine weighting
+ *
+ * The sums are stored in \p comBuffer for global summation. With \p numThreads > 1
+ * the local atoms are split over threads, \p comSums should then have one entry per thread.
+ */
+static void sumComGroup(const pull_group_work_t& pgrp,
+                        gmx::RVec*               pbcAtom,
+                        const rvec*              x,
+                        const rvec*              xp,
+                        const t_mdatoms*         md,
+                        const t_pbc*             pbc,
+                        int                      numThreads,
+                        gmx::ArrayRef<ComSums>   comSums,
+                        gmx::ArrayRef<gmx::DVec> comBuffer)
+{
+    rvec x_pbc = { 0, 0, 0 };
+
+    switch (pgrp.epgrppbc)
+    {
+        case epgrppbcREFAT:
+            /* Set the pbc atom */
+            copy_rvec(*pbcAtom, x_pbc);
+            break;
+        case epgrppbcPREVSTEPCOM:
+            /* Set the pbc reference to the COM of the group of the last step */
+            copy_dvec_to_rvec(pgrp.x_prev_step, *pbcAtom);
+            copy_dvec_to_rvec(pgrp.x_prev_step, x_pbc);
+    }
+
+    /* The final sums should end up in comSums[0] */
+    ComSums& comSumsTotal = comSums[0];
+
+    /* If we have a single-atom group the mass is irrelevant, so
+     * we can remove the mass factor to avoid division by zero.
+     * Note that with constraint pulling the mass does matter, but
+     * in that case a check group mass != 0 has been done before.
+     */
+    if (pgrp.params.nat == 1 && pgrp.atomSet.numAtomsLocal() == 1
+        && md->massT[pgrp.atomSet.localIndex()[0]] == 0)
+    {
+        GMX_ASSERT(xp == nullptr,
+                   "We should not have groups with zero mass with constraints, i.e. "
+                   "xp!=NULL");
+
+        /* Copy the single atom coordinate */
+        for (int d = 0; d < DIM; d++)
+        {
+            comSumsTotal.sum_wmx[d] = x[pgrp.atomSet.localIndex()[0]][d];
+        }
+        /* Set all mass factors to 1 to get the correct COM */
+        comSumsTotal.sum_wm  = 1;
+        comSumsTotal.sum_wwm = 1;
+    }
+    else if (numThreads == 1)
+    {
+        sum_com_part(&pgrp, 0, pgrp.atomSet.numAtomsLocal(), x, xp, md->massT, pbc, x_pbc,
+                     &comSumsTotal);
+    }
+    else
+    {
+#pragma omp parallel for num_threads(numThreads) schedule(static)
+        for (int t = 0; t < numThreads; t++)
+        {
+            int ind_start = (pgrp.atomSet.numAtomsLocal() * (t + 0)) / numThreads;
+            int ind_end   = (pgrp.atomSet.numAtomsLocal() * (t + 1)) / numThreads;
+            sum_com_part(&pgrp, ind_start, ind_end, x, xp, md->massT, pbc, x_pbc, &comSums[t]);
+        }
+
+        /* Reduce the thread contributions to sum_com[0] */
+        for (int t = 1; t < numThreads; t++)
+        {
+            comSumsTotal.sum_wm += comSums[t].sum_wm;
+            comSumsTotal.sum_wwm += comSums[t].sum_wwm;
+            dvec_inc(comSumsTotal.sum_wmx, comSums[t].sum_wmx);
+            dvec_inc(comSumsTotal.sum_wmxp, comSums[t].sum_wmxp);
+        }
+    }
+
+    if (pgrp.localWeights.empty())
+    {
+        comSumsTotal.sum_wwm = comSumsTotal.sum_wm;
+    }
+
+    /* Copy local sums to a buffer for global summing */
+    copy_dvec(comSumsTotal.sum_wmx, comBuffer[0]);
+
+    copy_dvec(comSumsTotal.sum_wmxp, comBuffer[1]);
+
+    comBuffer[2][0] = comSumsTotal.sum_wm;
+    comBuffer[2][1] = comSumsTotal.sum_wwm;
+    comBuffer[2][2] = 0;
+}
+
 /* calculates center of mass of selection index from all coordinates x */
 // Compiler segfault with 2019_update_5 and 2020_initial
 #if defined(__INTEL_COMPILER) \
@@ -573,6 +669,35 @@ void pull_calc_coms(const t_commrec* cr,
         twopi_box = 2.0 * M_PI / pbc->box[pull->cosdim][pull->cosdim];
     }
 
+    /* Groups with few local atoms are summed by a single thread each.
+     * Distribute these groups over the threads, which is efficient
+     * with many small pull groups. Larger groups are handled below.
+     */
+    auto isSmallGroup = [](const pull_group_work_t& pgrp) {
+        return pgrp.needToCalcCom && pgrp.epgrppbc != epgrppbcCOS
+               && pgrp.atomSet.numAtomsLocal() <= c_pullMaxNumLocalAtomsSingleThreaded;
+    };
+    const int numSmallGroups = std::count_if(pull->group.begin(), pull->group.end(), isSmallGroup);
+#pragma omp parallel for num_threads(pull->nthreads) schedule(static) if (numSmallGroups > 1)
+    for (int g = 0; g < gmx::ssize(pull->group); g++)
+    {
+        try
+        {
+            const pull_group_work_t& pgrp = pull->group[g];
+
+            if (isSmallGroup(pgrp))
+            {
+                /* Zero-initialize, since sum_wmxp is not set without xp */
+                ComSums comSums = {};
+                auto    comBuffer = gmx::arrayRefFromArray(
+                        comm->comBuffer.data() + g * c_comBufferStride, c_comBufferStride);
+                sumComGroup(pgrp, &comm->pbcAtomBuffer[g], x, xp, md, pbc, 1,
+                            gmx::arrayRefFromArray(&comSums, 1), comBuffer);
+            }
+        }
+        GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR
+    }
+
     for (size_t g = 0; g < pull->group.size(); g++)
     {
         pull_group_work_t* pgrp = &pull->group[g];
@@ -593,83 +718,11 @@ void pull_calc_coms(const t_commrec* cr,
         {
             if (pgrp->epgrppbc != epgrppbcCOS)
             {
-                rvec x_pbc = { 0, 0, 0 };
-
-                switch (pgrp->epgrppbc)
-                {
-                    case epgrppbcREFAT:
-                        /* Set the pbc atom */
-                        copy_rvec(comm->pbcAtomBuffer[g], x_pbc);
-                        break;
-                    case epgrppbcPREVSTEPCOM:
-                        /* Set the pbc reference to the COM of the group of the last step */
-                        copy_dvec_to_rvec(pgrp->x_prev_step, comm->pbcAtomBuffer[g]);
-                        copy_dvec_to_rvec(pgrp->x_prev_step, x_pbc);
-                }
-
-                /* The final sums should end up in comSums[0] */
-                ComSums& comSumsTotal = pull->comSums[0];
-
-                /* If we have a single-atom group the mass is irrelevant, so
-                 * we can remove the mass factor to avoid division by zero.
-                 * Note that with constraint pulling the mass does matter, but
-                 * in that case a check group mass != 0 has been done before.
-                 */
-                if (pgrp->params.nat == 1 && pgrp->atomSet.numAtomsLocal() == 1
-                    && md->massT[pgrp->atomSet.localIndex()[0]] == 0)
-                {
-                    GMX_ASSERT(xp == nullptr,
-                               "We should not have groups with zero mass with constraints, i.e. "
-                               "xp!=NULL");
-
-                    /* Copy the single atom coordinate */
-                    for (int d = 0; d < DIM; d++)
-                    {
-                        comSumsTotal.sum_wmx[d] = x[pgrp->atomSet.localIndex()[0]][d];
-                    }
-                    /* Set all mass factors to 1 to get the correct COM */
-                    comSumsTotal.sum_wm  = 1;
-                    comSumsTotal.sum_wwm = 1;
-                }
-                else if (pgrp->atomSet.numAtomsLocal() <= c_pullMaxNumLocalAtomsSingleThreaded)
+                if (pgrp->atomSet.numAtomsLocal() > c_pullMaxNumLocalAtomsSingleThreaded)
                 {
-                    sum_com_part(pgrp, 0, pgrp->atomSet.numAtomsLocal(), x, xp, md->massT, pbc,
-                                 x_pbc, &comSumsTotal);
+                    sumComGroup(*pgrp, &comm->pbcAtomBuffer[g], x, xp, md, pbc, pull->nthreads,
+                                pull->comSums, comBuffer);
                 }
-                else
-                {
-#pragma omp parallel for num_threads(pull->nthreads) schedule(static)
-                    for (int t = 0; t < pull->nthreads; t++)
-                    {
-                        int ind_start = (pgrp->atomSet.numAtomsLocal() * (t + 0)) / pull->nthreads;
-                        int ind_end   = (pgrp->atomSet.numAtomsLocal() * (t + 1)) / pull->nthreads;
-                        sum_com_part(pgrp, ind_start, ind_end, x, xp, md->massT, pbc, x_pbc,
-                                     &pull->comSums[t]);
-                    }
-
-                    /* Reduce the thread contributions to sum_com[0] */
-                    for (int t = 1; t < pull->nthreads; t++)
-                    {
-                        comSumsTotal.sum_wm += pull->comSums[t].sum_wm;
-                        comSumsTotal.sum_wwm += pull->comSums[t].sum_wwm;
-                        dvec_inc(comSumsTotal.sum_wmx, pull->comSums[t].sum_wmx);
-                        dvec_inc(comSumsTotal.sum_wmxp, pull->comSums[t].sum_wmxp);
-                    }
-                }
-
-                if (pgrp->localWeights.empty())
-                {
-                    comSumsTotal.sum_wwm = comSumsTotal.sum_wm;
-                }
-
-                /* Copy local sums to a buffer for global summing */
-                copy_dvec(comSumsTotal.sum_wmx, comBuffer[0]);
-
-                copy_dvec(comSumsTotal.sum_wmxp, comBuffer[1]);
-
-                comBuffer[2][0] = comSumsTotal.sum_wm;
-                comBuffer[2][1] = comSumsTotal.sum_wwm;
-                comBuffer[2][2] = 0;
             }
             else
             {
@@ -44,10 +44,14 @@
  */
 #include "gmxpre.h"
 
+#include <algorithm>
+#include <vector>
+
 #include "gromacs/math/vec.h"
 #include "gromacs/selection/nbsearch.h"
 #include "gromacs/utility/arraysize.h"
 #include "gromacs/utility/exceptions.h"
+#include "gromacs/utility/gmxomp.h"
 
 #include "position.h"
 #include "selmethod.h"
@@ -73,8 +77,18 @@ struct t_methoddata_distance
     gmx::AnalysisNeighborhood nb;
     /** Neighborhood search for an invididual frame. */
     gmx::AnalysisNeighborhoodSearch nbsearch;
+    /** Whether each evaluated position is within the cutoff (for \p within). */
+    std::vector<char> bWithin;
 };
 
+/*! \brief
+ * Minimum number of evaluated positions per thread.
+ *
+ * Below this, the neighborhood searches are not worth splitting over
+ * OpenMP threads.
+ */
+static const int c_minPositionsPerThread = 1000;
+
 /*! \brief
  * Allocates data for distance-based selection methods.
  *
@@ -278,10 +292,17 @@ static void evaluate_distance(const gmx::SelMethodEvalContext& /*context*/,
 {
     t_methoddata_distance* d = static_cast<t_methoddata_distance*>(data);
 
-    out->nr = pos->count();
-    for (int i = 0; i < pos->count(); ++i)
+    const int count = pos->count();
+    out->nr         = count;
+    // The searches for different positions are independent.
+#pragma omp parallel for schedule(static) if (count >= 2 * c_minPositionsPerThread)
+    for (int i = 0; i < count; ++i)
     {
-        out->u.r[i] = d->nbsearch.minimumDistance(pos->x[i]);
+        try
+        {
+            out->u.r[i] = d->nbsearch.minimumDistance(pos->x[i]);
+        }
+        GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR
     }
 }
 
@@ -299,10 +320,37 @@ static void evaluate_within(const gmx::SelMethodEvalContext& /*context*/,
 {
     t_methoddata_distance* d = static_cast<t_methoddata_distance*>(data);
 
+    // Each thread searches a contiguous block of the positions, and only
+    // the first pair found for each position is used.
+    const int count = pos->count();
+    const int numThreads =
+            std::max(1, std::min(gmx_omp_get_max_threads(), count / c_minPositionsPerThread));
+    d->bWithin.assign(count, 0);
+#pragma omp parallel num_threads(numThreads)
+    {
+        try
+        {
+            const int thread = gmx_omp_get_thread_num();
+            const int begin  = (count * thread) / numThreads;
+            const int end    = (count * (thread + 1)) / numThreads;
+            if (begin < end)
+            {
+                gmx::AnalysisNeighborhoodPairSearch pairSearch = d->nbsearch.startPairSearch(
+                        gmx::AnalysisNeighborhoodPositions(pos->x + begin, end - begin));
+                gmx::AnalysisNeighborhoodPair pair;
+                while (pairSearch.findNextPair(&pair))
+                {
+                    d->bWithin[begin + pair.testIndex()] = 1;
+                    pairSearch.skipRemainingPairsForTestPosition();
+                }
+            }
+        }
+        GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR
+    }
     out->u.g->isize = 0;
-    for (int b = 0; b < pos->count(); ++b)
+    for (int b = 0; b < count; ++b)
     {
-        if (d->nbsearch.isWithin(pos->x[b]))
+        if (d->bWithin[b])
         {
             gmx_ana_pos_add_to_group(out->u.g, pos, b);
         }
@@ -445,7 +445,6 @@ static void init_frame_insolidangle(const gmx::SelMethodEvalContext& context, vo
     rvec                       dx;
     int                        i;
 
-    free_surface_points(d);
     clear_surface_points(d);
     for (i = 0; i < d->span.count(); ++i)
     {
@@ -676,6 +675,8 @@ static int find_surface_bin(t_methoddata_insolidangle* surf, rvec x)
  *
  * Clears the reference points from the bins and (re)initializes the edges
  * of the azimuthal bins.
+ * Memory allocated for the points is kept, such that it can be reused for
+ * subsequent frames.
  */
 static void clear_surface_points(t_methoddata_insolidangle* surf)
 {
@@ -741,7 +742,7 @@ static void add_surface_point(t_methoddata_insolidangle* surf, int tbin, int pbi
     /* Allocate more space if necessary */
     if (surf->bin[bin].n == surf->bin[bin].n_alloc)
     {
-        surf->bin[bin].n_alloc += 10;
+        surf->bin[bin].n_alloc = max(2 * surf->bin[bin].n_alloc, 10);
         srenew(surf->bin[bin].x, surf->bin[bin].n_alloc);
     }
     /* Add the point to the bin */
@@ -47,8 +47,10 @@
 #include <cstdlib>
 #include <ctime>
 
+#include <algorithm>
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "gromacs/domdec/domdec_struct.h"
@@ -678,7 +680,30 @@ static void detect_flux_per_channel(t_swapgrp*     g,
 }
 
 
-/*! \brief Determines which ions or solvent molecules are in compartment A and B */
+/*! \brief Warn when not all molecules of a group were assigned to exactly one compartment. */
+static void checkCompartmentAssignment(const t_swapgrp* g, const int nMolNotInComp[eCompNR])
+{
+    const auto numMolecules = static_cast<int>(g->atomset.numAtomsGlobal() / g->apm);
+    if (nMolNotInComp[eCompA] + nMolNotInComp[eCompB] != numMolecules)
+    {
+        fprintf(stderr,
+                "%s Warning: Inconsistency while assigning '%s' molecules to compartments. !inA: "
+                "%d, !inB: %d, total molecules %d\n",
+                SwS, g->molname, nMolNotInComp[eCompA], nMolNotInComp[eCompB], numMolecules);
+    }
+
+    int sum = g->comp[eCompA].nMol + g->comp[eCompB].nMol;
+    if (sum != numMolecules)
+    {
+        fprintf(stderr,
+                "%s Warning: %d molecules are in group '%s', but altogether %d have been assigned "
+                "to the compartments.\n",
+                SwS, numMolecules, g->molname, sum);
+    }
+}
+
+
+/*! \brief Determines which ions are in compartment A and B */
 static void sortMoleculesIntoCompartments(t_swapgrp*    g,
                                           t_commrec*    cr,
                                           t_swapcoords* sc,
@@ -686,8 +711,7 @@ static void sortMoleculesIntoCompartments(t_swapgrp*    g,
                                           const matrix  box,
                                           int64_t       step,
                                           FILE*         fpout,
-                                          gmx_bool      bRerun,
-                                          gmx_bool      bIsSolvent)
+                                          gmx_bool      bRerun)
 {
     int  nMolNotInComp[eCompNR]; /* consistency check */
     real cyl0_r2 = sc->cyl0r * sc->cyl0r;
@@ -722,7 +746,7 @@ static void sortMoleculesIntoCompartments(t_swapgrp*    g,
                 add_to_list(iAtom, &g->comp[comp], dist);
 
                 /* Master also checks for ion groups through which channel each ion has passed */
-                if (MASTER(cr) && (g->comp_now != nullptr) && !bIsSolvent)
+                if (MASTER(cr) && (g->comp_now != nullptr))
                 {
                     int globalAtomNr = g->atomset.globalIndex()[iAtom] + 1; /* PDB index starts at 1 ... */
                     detect_flux_per_channel(g, globalAtomNr, comp, g->xc[iAtom], &g->comp_now[iMol],
@@ -736,14 +760,11 @@ static void sortMoleculesIntoCompartments(t_swapgrp*    g,
             }
         }
         /* Correct the time-averaged number of ions in the compartment */
-        if (!bIsSolvent)
-        {
-            update_time_window(&g->comp[comp], sc->nAverage, replace);
-        }
+        update_time_window(&g->comp[comp], sc->nAverage, replace);
     }
 
     /* Flux detection warnings */
-    if (MASTER(cr) && !bIsSolvent)
+    if (MASTER(cr))
     {
         if (g->nCylBoth > 0)
         {
@@ -761,30 +782,218 @@ static void sortMoleculesIntoCompartments(t_swapgrp*    g,
         }
     }
 
-    if (bIsSolvent && nullptr != fpout)
+    /* Consistency checks */
+    checkCompartmentAssignment(g, nMolNotInComp);
+}
+
+
+/*! \internal \brief
+ * The solvent molecules that are exchanged with ions in a swap step.
+ *
+ * Only the molecules that are closest to the bulk layers are needed for the
+ * position exchanges, so we only communicate these instead of assembling
+ * the positions of the whole solvent group.
+ */
+struct SwapSolventSelection
+{
+    //! Collective indices of the first atoms of the selected molecules, closest to bulk first
+    std::vector<int> firstAtom[eCompNR];
+    //! The number of selected molecules of each compartment that were used for exchanges
+    int numUsed[eCompNR] = { 0, 0 };
+    //! Pairs of molecule index and position slot, sorted by molecule index
+    std::vector<std::pair<int, int>> moleculeSlots;
+    //! Positions of the selected molecules, apm entries per slot
+    std::vector<gmx::RVec> x;
+};
+
+
+/*! \brief Return the buffer position slot of solvent atom \p ci, or -1 when it is not selected. */
+static int getSelectedSolventSlot(const SwapSolventSelection& selection, int ci, int apm)
+{
+    const std::pair<int, int> key(ci / apm, -1);
+    const auto                it = std::lower_bound(selection.moleculeSlots.begin(),
+                                         selection.moleculeSlots.end(), key);
+
+    if (it != selection.moleculeSlots.end() && it->first == key.first)
+    {
+        return it->second;
+    }
+
+    return -1;
+}
+
+
+/*! \brief Sort the solvent molecules into compartments and select swap partners.
+ *
+ * Each rank assigns its local solvent molecules to the compartments, using
+ * the first atom of each molecule, like sortMoleculesIntoCompartments() does
+ * for the collective array. Only the molecule counts and, per compartment,
+ * the \p numRequired local molecules closest to the bulk layer are summed over
+ * the ranks. From these all ranks choose the same molecules, after which
+ * only the positions of the chosen molecules are assembled.
+ *
+ * \param[in]  g           The solvent group.
+ * \param[in]  cr          Communication record.
+ * \param[in]  sc          Swap parameters from the input record.
+ * \param[in]  s           Swap data.
+ * \param[in]  box         The simulation box.
+ * \param[in]  x           The local positions.
+ * \param[in]  numRequired Number of solvent molecules needed for exchanges per compartment.
+ * \param[in]  fpout       Swap output file, can be nullptr.
+ * \param[out] selection   The selected solvent molecules and their positions.
+ */
+static void selectSolventMolecules(t_swapgrp*            g,
+                                   const t_commrec*      cr,
+                                   const t_swapcoords*   sc,
+                                   t_swap*               s,
+                                   const matrix          box,
+                                   const rvec            x[],
+                                   const int             numRequired[eCompNR],
+                                   FILE*                 fpout,
+                                   SwapSolventSelection* selection)
+{
+    const int sd  = s->swapdim;
+    const int apm = g->apm;
+
+    /* The buffer contains the local counts of molecules in and not in each
+     * compartment, followed by one slot per rank with the (distance, index)
+     * pairs of the local candidates for all compartments.
+     */
+    const int           numRanks = DOMAINDECOMP(cr) ? cr->dd->nnodes : 1;
+    const int           rank     = DOMAINDECOMP(cr) ? cr->dd->rank : 0;
+    const int           slotSize = 2 * (numRequired[eCompA] + numRequired[eCompB]);
+    std::vector<double> buffer(2 * eCompNR + numRanks * slotSize, 0.0);
+    double*             candidateBuffer = buffer.data() + 2 * eCompNR + rank * slotSize;
+
+    std::vector<std::pair<real, int>> candidates;
+    for (int comp = eCompA; comp <= eCompB; comp++)
+    {
+        real left, right;
+
+        get_compartment_boundaries(comp, s, box, &left, &right);
+
+        candidates.clear();
+        int  numNotInComp    = 0;
+        auto collectiveIndex = g->atomset.collectiveIndex().begin();
+        for (const auto localIndex : g->atomset.localIndex())
+        {
+            /* Only the first atom of a molecule decides the compartment */
+            if (*collectiveIndex % apm == 0)
+            {
+                real dist;
+
+                if (compartment_contains_atom(left, right, x[localIndex][sd], box[sd][sd],
+                                              sc->bulkOffset[comp], &dist))
+                {
+                    candidates.emplace_back(dist, *collectiveIndex);
+                }
+                else
+                {
+                    numNotInComp++;
+                }
+            }
+            ++collectiveIndex;
+        }
+        buffer[comp]           = candidates.size();
+        buffer[eCompNR + comp] = numNotInComp;
+
+        /* Order by distance and then by index, such that the choice does not
+         * depend on the decomposition */
+        const auto numKeep = std::min<size_t>(candidates.size(), numRequired[comp]);
+        std::partial_sort(candidates.begin(), candidates.begin() + numKeep, candidates.end());
+        for (size_t i = 0; i < static_cast<size_t>(numRequired[comp]); i++)
+        {
+            /* Mark unused entries with index -1 */
+            candidateBuffer[2 * i]     = (i < numKeep) ? candidates[i].first : 0;
+            candidateBuffer[2 * i + 1] = (i < numKeep) ? candidates[i].second : -1;
+        }
+        candidateBuffer += 2 * numRequired[comp];
+    }
+
+    if (PAR(cr))
+    {
+        gmx_sumd(buffer.size(), buffer.data(), cr);
+    }
+
+    int nMolNotInComp[eCompNR];
+    selection->moleculeSlots.clear();
+    for (int comp = eCompA; comp <= eCompB; comp++)
+    {
+        g->comp[comp].nMol       = static_cast<int>(buffer[comp]);
+        g->comp[comp].nMolBefore = g->comp[comp].nMol;
+        nMolNotInComp[comp]      = static_cast<int>(buffer[eCompNR + comp]);
+
+        /* Merge the candidates of all ranks */
+        const int offset = (comp == eCompA) ? 0 : 2 * numRequired[eCompA];
+        candidates.clear();
+        for (int r = 0; r < numRanks; r++)
+        {
+            const double* rankCandidates = buffer.data() + 2 * eCompNR + r * slotSize + offset;
+            for (int i = 0; i < numRequired[comp] && rankCandidates[2 * i + 1] >= 0; i++)
+            {
+                candidates.emplace_back(static_cast<real>(rankCandidates[2 * i]),
+                                        static_cast<int>(rankCandidates[2 * i + 1]));
+            }
+        }
+        const auto numKeep = std::min<size_t>(candidates.size(), numRequired[comp]);
+        std::partial_sort(candidates.begin(), candidates.begin() + numKeep, candidates.end());
+
+        selection->firstAtom[comp].resize(numKeep);
+        selection->numUsed[comp] = 0;
+        for (size_t i = 0; i < numKeep; i++)
+        {
+            selection->firstAtom[comp][i] = candidates[i].second;
+            selection->moleculeSlots.emplace_back(candidates[i].second / apm,
+                                                  selection->moleculeSlots.size());
+        }
+    }
+    std::sort(selection->moleculeSlots.begin(), selection->moleculeSlots.end());
+
+    if (nullptr != fpout)
     {
         fprintf(fpout, "# Solv. molecules in comp.%s: %d   comp.%s: %d\n", CompStr[eCompA],
                 g->comp[eCompA].nMol, CompStr[eCompB], g->comp[eCompB].nMol);
     }
 
-    /* Consistency checks */
-    const auto numMolecules = static_cast<int>(g->atomset.numAtomsGlobal() / g->apm);
-    if (nMolNotInComp[eCompA] + nMolNotInComp[eCompB] != numMolecules)
+    checkCompartmentAssignment(g, nMolNotInComp);
+
+    /* Assemble the positions of the selected molecules */
+    selection->x.assign(selection->moleculeSlots.size() * apm, { 0, 0, 0 });
+    auto collectiveIndex = g->atomset.collectiveIndex().begin();
+    for (const auto localIndex : g->atomset.localIndex())
     {
-        fprintf(stderr,
-                "%s Warning: Inconsistency while assigning '%s' molecules to compartments. !inA: "
-                "%d, !inB: %d, total molecules %d\n",
-                SwS, g->molname, nMolNotInComp[eCompA], nMolNotInComp[eCompB], numMolecules);
+        const int slot = getSelectedSolventSlot(*selection, *collectiveIndex, apm);
+        if (slot >= 0)
+        {
+            copy_rvec(x[localIndex], selection->x[slot * apm + *collectiveIndex % apm]);
+        }
+        ++collectiveIndex;
     }
 
-    int sum = g->comp[eCompA].nMol + g->comp[eCompB].nMol;
-    if (sum != numMolecules)
+    if (PAR(cr))
     {
-        fprintf(stderr,
-                "%s Warning: %d molecules are in group '%s', but altogether %d have been assigned "
-                "to the compartments.\n",
-                SwS, numMolecules, g->molname, sum);
+        gmx_sum(selection->x.size() * DIM, as_rvec_array(selection->x.data())[0], cr);
+    }
+}
+
+
+/*! \brief Return the positions of the next selected solvent molecule of compartment \p comp. */
+static rvec* getNextSelectedSolventMolecule(SwapSolventSelection* selection,
+                                            const t_swapgrp*      g,
+                                            int                   comp)
+{
+    if (selection->numUsed[comp] >= static_cast<int>(selection->firstAtom[comp].size()))
+    {
+        gmx_fatal(FARGS,
+                  "Could not get index of %s atom. Compartment contains %d %s molecules before "
+                  "swaps.",
+                  g->molname, g->comp[comp].nMolBefore, g->molname);
     }
+
+    const int ci   = selection->firstAtom[comp][selection->numUsed[comp]++];
+    const int slot = getSelectedSolventSlot(*selection, ci, g->apm);
+
+    return as_rvec_array(selection->x.data()) + slot * g->apm;
 }
 
 
@@ -815,7 +1024,7 @@ static void get_initial_ioncounts(const t_inputrec* ir,
         }
 
         /* Set up the compartments and get lists of atoms in each compartment */
-        sortMoleculesIntoCompartments(g, cr, sc, s, box, 0, s->fpout, bRerun, FALSE);
+        sortMoleculesIntoCompartments(g, cr, sc, s, box, 0, s->fpout, bRerun);
 
         /* Set initial molecule counts if requested (as signaled by "-1" value) */
         for (int ic = 0; ic < eCompNR; ic++)
@@ -1524,11 +1733,15 @@ t_swap* init_swapcoords(FILE*                       fplog,
     check_swap_groups(s, mtop->natoms, bVerbose && MASTER(cr));
 
     /* Allocate space for the collective arrays for all groups */
-    /* For the collective position array */
+    /* For the collective position array, not needed for the solvent,
+     * since only the solvent molecules that are exchanged get communicated */
     for (int i = 0; i < s->ngrp; i++)
     {
         g = &s->group[i];
-        snew(g->xc, g->atomset.numAtomsGlobal());
+        if (i != eGrpSolvent)
+        {
+            snew(g->xc, g->atomset.numAtomsGlobal());
+        }
 
         /* For the split groups (the channels) we need some extra memory to
          * be able to make the molecules whole even if they span more than
@@ -1832,6 +2045,40 @@ static gmx_bool need_swap(t_swapcoords* sc, t_swap* s)
 }
 
 
+/*! \brief Determine how many solvent molecules each compartment needs for position exchanges.
+ *
+ * Uses the same vacancy bookkeeping as the exchange loop in do_swapcoords().
+ */
+static void countRequiredSwaps(const t_swapcoords* sc, const t_swap* s, int numSwaps[eCompNR])
+{
+    for (int ic = 0; ic < eCompNR; ic++)
+    {
+        numSwaps[ic] = 0;
+    }
+
+    for (int ig = eSwapFixedGrpNR; ig < s->ngrp; ig++)
+    {
+        real vacancy[eCompNR];
+        for (int ic = 0; ic < eCompNR; ic++)
+        {
+            vacancy[ic] = s->group[ig].vacancy[ic];
+        }
+
+        for (int thisC = 0; thisC < eCompNR; thisC++)
+        {
+            int otherC = (thisC + 1) % eCompNR;
+
+            while (vacancy[thisC] >= sc->threshold)
+            {
+                vacancy[thisC]--;
+                vacancy[otherC]++;
+                numSwaps[thisC]++;
+            }
+        }
+    }
+}
+
+
 /*! \brief Return the index of an atom or molecule suitable for swapping.
  *
  * Returns the index of an atom that is far off the compartment boundaries,
@@ -1919,6 +2166,24 @@ static void apply_modified_positions(swap_group* g, rvec x[])
 }
 
 
+/*! \brief Write back the modified positions of the selected solvent molecules. */
+static void apply_modified_solvent_positions(const swap_group*           g,
+                                             const SwapSolventSelection& selection,
+                                             rvec                        x[])
+{
+    auto collectiveIndex = g->atomset.collectiveIndex().begin();
+    for (const auto localIndex : g->atomset.localIndex())
+    {
+        const int slot = getSelectedSolventSlot(selection, *collectiveIndex, g->apm);
+        if (slot >= 0)
+        {
+            copy_rvec(selection.x[slot * g->apm + *collectiveIndex % g->apm], x[localIndex]);
+        }
+        ++collectiveIndex;
+    }
+}
+
+
 gmx_bool do_swapcoords(t_commrec*     cr,
                        int64_t        step,
                        double         t,
@@ -1935,7 +2200,7 @@ gmx_bool do_swapcoords(t_commrec*     cr,
     int           thisC, otherC; /* Index into this compartment and the other one */
     gmx_bool      bSwap = FALSE;
     t_swapgrp *   g, *gsol;
-    int           isol, iion;
+    int           iion;
     rvec          com_solvent, com_particle; /* solvent and swap molecule's center of mass */
 
 
@@ -1971,7 +2236,7 @@ gmx_bool do_swapcoords(t_commrec*     cr,
                                     g->atomset.collectiveIndex().data(), nullptr, nullptr);
 
         /* Determine how many ions of this type each compartment contains */
-        sortMoleculesIntoCompartments(g, cr, sc, s, box, step, s->fpout, bRerun, FALSE);
+        sortMoleculesIntoCompartments(g, cr, sc, s, box, step, s->fpout, bRerun);
     }
 
     /* Output how many ions are in the compartments */
@@ -1991,20 +2256,6 @@ gmx_bool do_swapcoords(t_commrec*     cr,
     bSwap = need_swap(sc, s);
     if (bSwap)
     {
-        /* Since we here know that we have to perform ion/water position exchanges,
-         * we now assemble the solvent positions */
-        g = &(s->group[eGrpSolvent]);
-        communicate_group_positions(cr, g->xc, nullptr, nullptr, FALSE, x, g->atomset.numAtomsGlobal(),
-                                    g->atomset.numAtomsLocal(), g->atomset.localIndex().data(),
-                                    g->atomset.collectiveIndex().data(), nullptr, nullptr);
-
-        /* Determine how many molecules of solvent each compartment contains */
-        sortMoleculesIntoCompartments(g, cr, sc, s, box, step, s->fpout, bRerun, TRUE);
-
-        /* Save number of solvent molecules per compartment prior to any swaps */
-        g->comp[eCompA].nMolBefore = g->comp[eCompA].nMol;
-        g->comp[eCompB].nMolBefore = g->comp[eCompB].nMol;
-
         for (ig = eSwapFixedGrpNR; ig < s->ngrp; ig++)
         {
             g = &(s->group[ig]);
@@ -2019,6 +2270,16 @@ gmx_bool do_swapcoords(t_commrec*     cr,
             }
         }
 
+        /* Since we here know that we have to perform ion/water position exchanges,
+         * determine how many molecules of solvent each compartment contains and
+         * assemble the positions of the solvent molecules that will be exchanged.
+         * This also saves the number of solvent molecules prior to any swaps. */
+        int numSolventRequired[eCompNR];
+        countRequiredSwaps(sc, s, numSolventRequired);
+        SwapSolventSelection solventSelection;
+        selectSolventMolecules(&s->group[eGrpSolvent], cr, sc, s, box, x, numSolventRequired,
+                               s->fpout, &solventSelection);
+
         /* Now actually perform the particle exchanges, one swap group after another */
         gsol = &s->group[eGrpSolvent];
         for (ig = eSwapFixedGrpNR; ig < s->ngrp; ig++)
@@ -2034,17 +2295,17 @@ gmx_bool do_swapcoords(t_commrec*     cr,
                 {
                     /* Swap in an ion */
 
-                    /* Get the xc-index of the first atom of a solvent molecule of this compartment */
-                    isol = get_index_of_distant_atom(&gsol->comp[thisC], gsol->molname);
+                    /* Get the positions of a solvent molecule of this compartment */
+                    rvec* xsol = getNextSelectedSolventMolecule(&solventSelection, gsol, thisC);
 
                     /* Get the xc-index of a particle from the other compartment */
                     iion = get_index_of_distant_atom(&g->comp[otherC], g->molname);
 
-                    get_molecule_center(&gsol->xc[isol], gsol->apm, gsol->m, com_solvent, s->pbc);
+                    get_molecule_center(xsol, gsol->apm, gsol->m, com_solvent, s->pbc);
                     get_molecule_center(&g->xc[iion], g->apm, g->m, com_particle, s->pbc);
 
                     /* Subtract solvent molecule's center of mass and add swap particle's center of mass */
-                    translate_positions(&gsol->xc[isol], gsol->apm, com_solvent, com_particle, s->pbc);
+                    translate_positions(xsol, gsol->apm, com_solvent, com_particle, s->pbc);
                     /* Similarly for the swap particle, subtract com_particle and add com_solvent */
                     translate_positions(&g->xc[iion], g->apm, com_particle, com_solvent, s->pbc);
 
@@ -2089,7 +2350,8 @@ gmx_bool do_swapcoords(t_commrec*     cr,
 
         /* For the solvent and user-defined swap groups, each rank writes back its
          * (possibly modified) local positions to the official position array. */
-        for (ig = eGrpSolvent; ig < s->ngrp; ig++)
+        apply_modified_solvent_positions(gsol, solventSelection, x);
+        for (ig = eSwapFixedGrpNR; ig < s->ngrp; ig++)
         {
             g = &s->group[ig];
             apply_modified_positions(g, x);
@@ -0,0 +1,305 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2020, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for gmx trjcat.
+ */
+#include "gmxpre.h"
+
+#include "gromacs/tools/trjcat.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "gromacs/fileio/gmxfio.h"
+#include "gromacs/fileio/oenv.h"
+#include "gromacs/fileio/trxio.h"
+#include "gromacs/fileio/xtcio.h"
+#include "gromacs/math/vectypes.h"
+#include "gromacs/trajectory/trajectoryframe.h"
+
+#include "testutils/cmdlinetest.h"
+#include "testutils/stdiohelper.h"
+#include "testutils/testfilemanager.h"
+
+namespace
+{
+
+//! Step, time and coordinates of a trajectory frame.
+struct Frame
+{
+    int64_t                step;
+    real                   time;
+    std::vector<gmx::RVec> x;
+};
+
+//! Returns all frames in \p filename.
+std::vector<Frame> readFrames(const std::string& filename)
+{
+    gmx_output_env_t* oenv;
+    output_env_init_default(&oenv);
+    t_trxstatus*       status;
+    t_trxframe         fr;
+    std::vector<Frame> frames;
+    if (read_first_frame(oenv, &status, filename.c_str(), &fr, TRX_NEED_X))
+    {
+        do
+        {
+            frames.push_back({ fr.step, fr.time, { fr.x, fr.x + fr.natoms } });
+        } while (read_next_frame(oenv, status, &fr));
+        close_trx(status);
+        done_frame(&fr);
+    }
+    output_env_done(oenv);
+    return frames;
+}
+
+/*! \brief Writes \p numFrames frames of \p numAtoms atoms to an XTC file
+ * with 100 steps of 0.2 ps between frames.
+ *
+ * Frames with more than 9 atoms are compressed, smaller frames are
+ * stored as plain floats. */
+void writeXtc(const std::string& filename, int numFrames, int numAtoms)
+{
+    const matrix           box = { { 2, 0, 0 }, { 0, 2, 0 }, { 0, 0, 2 } };
+    std::vector<gmx::RVec> x(numAtoms);
+    t_fileio*              fio = open_xtc(filename.c_str(), "w");
+    for (int f = 0; f < numFrames; f++)
+    {
+        for (int a = 0; a < numAtoms; a++)
+        {
+            x[a][XX] = 0.1 * a + 0.01 * f;
+            x[a][YY] = 0.2 * a - 0.03 * f;
+            x[a][ZZ] = 0.05 * a * f;
+        }
+        ASSERT_TRUE(write_xtc(fio, numAtoms, 100 * f, 0.2 * f, box, as_rvec_array(x.data()), 1000));
+    }
+    close_xtc(fio);
+}
+
+//! Returns the file offsets of the frames in the XTC file \p filename.
+std::vector<gmx_off_t> xtcFrameOffsets(const std::string& filename)
+{
+    std::vector<gmx_off_t> offsets;
+    t_fileio*              fio = open_xtc(filename.c_str(), "r");
+    t_xtc_packed_frame     frame;
+    gmx_off_t              offset = gmx_fio_ftell(fio);
+    gmx_bool               bOK;
+    while (read_next_xtc_packed(fio, &frame, &bOK) && bOK)
+    {
+        offsets.push_back(offset);
+        offset = gmx_fio_ftell(fio);
+    }
+    close_xtc(fio);
+    return offsets;
+}
+
+//! Returns the contents of the file \p filename.
+std::vector<char> readBytes(const std::string& filename)
+{
+    std::ifstream stream(filename, std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(stream),
+                             std::istreambuf_iterator<char>());
+}
+
+/*! \brief Expects that the XTC files \p expected and \p actual have
+ * the same bytes, except for the step and time in the frame headers.
+ *
+ * The header of a frame is the magic number, the number of atoms,
+ * the step and the time, all 4 bytes. */
+void compareXtcBytesExceptStepAndTime(const std::string& expected, const std::string& actual)
+{
+    const std::vector<char> expectedBytes = readBytes(expected);
+    std::vector<char>       actualBytes   = readBytes(actual);
+    ASSERT_EQ(expectedBytes.size(), actualBytes.size());
+    const auto offsets = xtcFrameOffsets(expected);
+    ASSERT_FALSE(offsets.empty());
+    EXPECT_EQ(offsets, xtcFrameOffsets(actual));
+    for (gmx_off_t offset : offsets)
+    {
+        std::copy(expectedBytes.begin() + offset + 8, expectedBytes.begin() + offset + 16,
+                  actualBytes.begin() + offset + 8);
+    }
+    EXPECT_TRUE(expectedBytes == actualBytes);
+}
+
+//! Expects that \p actual has exactly the same coordinates as \p expected.
+void compareCoordinates(const std::vector<gmx::RVec>& expected,
+                        const std::vector<gmx::RVec>& actual)
+{
+    ASSERT_EQ(expected.size(), actual.size());
+    for (size_t a = 0; a < expected.size(); a++)
+    {
+        for (int d = 0; d < DIM; d++)
+        {
+            EXPECT_EQ(expected[a][d], actual[a][d]);
+        }
+    }
+}
+
+//! Expects that \p actual has the same steps, times and coordinates as \p expected.
+void compareFrames(const std::vector<Frame>& expected, const std::vector<Frame>& actual)
+{
+    ASSERT_EQ(expected.size(), actual.size());
+    for (size_t i = 0; i < expected.size(); i++)
+    {
+        EXPECT_EQ(expected[i].step, actual[i].step);
+        EXPECT_EQ(expected[i].time, actual[i].time);
+        compareCoordinates(expected[i].x, actual[i].x);
+    }
+}
+
+class TrjcatTest : public gmx::test::CommandLineTestBase
+{
+public:
+    /*! \brief Runs trjcat on \p inputFile with the given extra options and returns the output frames.
+     *
+     * With \p useIndex, the output group is selected from an index
+     * file, which makes trjcat decompress and recompress the XTC frames
+     * instead of copying them packed.
+     */
+    std::vector<Frame> runTrjcat(const std::string&              inputFile,
+                                 const std::vector<std::string>& options,
+                                 const char*                     stdinInput,
+                                 bool                            useIndex)
+    {
+        gmx::test::CommandLine cmdline;
+        cmdline.append("trjcat");
+        const std::string outputFile =
+                fileManager().getTemporaryFilePath(useIndex ? "unpacked.xtc" : "packed.xtc");
+        cmdline.addOption("-f", inputFile);
+        cmdline.addOption("-o", outputFile);
+        for (const std::string& option : options)
+        {
+            cmdline.append(option);
+        }
+        std::string input = stdinInput;
+        if (useIndex)
+        {
+            cmdline.addOption("-n", fileManager().getInputFilePath("spc2.ndx"));
+            input = "System\n" + input;
+        }
+        gmx::test::StdioTestHelper stdioHelper(&fileManager());
+        stdioHelper.redirectStringToStdin(input.c_str());
+        EXPECT_EQ(0, gmx_trjcat(cmdline.argc(), cmdline.argv()));
+
+        return readFrames(outputFile);
+    }
+};
+
+TEST_F(TrjcatTest, CopiesXtcFramesUnchanged)
+{
+    const std::string inputFile = fileManager().getInputFilePath("spc2-traj.xtc");
+
+    const auto input  = readFrames(inputFile);
+    const auto output = runTrjcat(inputFile, {}, "", false);
+    ASSERT_FALSE(input.empty());
+    compareFrames(input, output);
+}
+
+TEST_F(TrjcatTest, PackedCopyMatchesRecompressionWithNewTimes)
+{
+    const std::string inputFile = fileManager().getTemporaryFilePath("in.xtc");
+    writeXtc(inputFile, 6, 6);
+
+    const auto packed   = runTrjcat(inputFile, { "-settime", "-dt", "0.4" }, "10\n", false);
+    const auto unpacked = runTrjcat(inputFile, { "-settime", "-dt", "0.4" }, "10\n", true);
+    ASSERT_EQ(3, packed.size());
+    for (size_t i = 0; i < packed.size(); i++)
+    {
+        EXPECT_EQ(200 * i, packed[i].step);
+        EXPECT_FLOAT_EQ(10 + 0.4 * i, packed[i].time);
+    }
+    compareFrames(unpacked, packed);
+}
+
+TEST_F(TrjcatTest, CopiesCompressedXtcFramesBitIdentically)
+{
+    const std::string inputFile  = fileManager().getTemporaryFilePath("in.xtc");
+    const std::string outputFile = fileManager().getTemporaryFilePath("out.xtc");
+    writeXtc(inputFile, 4, 20);
+
+    t_fileio*          in  = open_xtc(inputFile.c_str(), "r");
+    t_fileio*          out = open_xtc(outputFile.c_str(), "w");
+    t_xtc_packed_frame frame;
+    gmx_bool           bOK;
+    int                numFrames = 0;
+    while (read_next_xtc_packed(in, &frame, &bOK) && bOK)
+    {
+        EXPECT_EQ(20, frame.natoms);
+        EXPECT_EQ(1000, frame.precision);
+        frame.step += 1000;
+        frame.time += 5;
+        EXPECT_TRUE(write_xtc_packed(out, &frame));
+        numFrames++;
+    }
+    close_xtc(in);
+    close_xtc(out);
+    EXPECT_EQ(4, numFrames);
+
+    const auto input  = readFrames(inputFile);
+    const auto output = readFrames(outputFile);
+    ASSERT_EQ(input.size(), output.size());
+    for (size_t i = 0; i < input.size(); i++)
+    {
+        EXPECT_EQ(input[i].step + 1000, output[i].step);
+        EXPECT_FLOAT_EQ(input[i].time + 5, output[i].time);
+        compareCoordinates(input[i].x, output[i].x);
+    }
+    compareXtcBytesExceptStepAndTime(inputFile, outputFile);
+}
+
+TEST_F(TrjcatTest, CopiesCompressedXtcFramesWithNewTimes)
+{
+    const std::string inputFile = fileManager().getTemporaryFilePath("in.xtc");
+    writeXtc(inputFile, 4, 20);
+
+    const auto input  = readFrames(inputFile);
+    /* trjcat keeps its options in static variables, so reset -dt from earlier tests */
+    const auto output = runTrjcat(inputFile, { "-settime", "-dt", "0" }, "10\n", false);
+    ASSERT_EQ(input.size(), output.size());
+    for (size_t i = 0; i < input.size(); i++)
+    {
+        EXPECT_EQ(input[i].step, output[i].step);
+        EXPECT_FLOAT_EQ(10 + 0.2 * i, output[i].time);
+        compareCoordinates(input[i].x, output[i].x);
+    }
+    compareXtcBytesExceptStepAndTime(inputFile, fileManager().getTemporaryFilePath("packed.xtc"));
+}
+
+} // namespace
@@ -150,6 +150,34 @@ static void scan_trj_files(gmx::ArrayRef<const std::string> files,
     fprintf(stderr, "\n");
 }
 
+/*! \brief Reads the next XTC frame without decompressing it.
+ *
+ * Fills the fields of \p fr that are used for selecting frames to write.
+ */
+static bool read_next_packed_frame(t_fileio* fio, t_xtc_packed_frame* packed, t_trxframe* fr)
+{
+    gmx_bool bOK;
+    if (!read_next_xtc_packed(fio, packed, &bOK))
+    {
+        if (!bOK)
+        {
+            fprintf(stderr, "\nWARNING: Incomplete frame after time %g\n", fr->time);
+        }
+        return false;
+    }
+    clear_trxframe(fr, FALSE);
+    fr->natoms = packed->natoms;
+    fr->bStep  = TRUE;
+    fr->step   = packed->step;
+    fr->bTime  = TRUE;
+    fr->time   = packed->time;
+    fr->bBox   = TRUE;
+    copy_mat(packed->box, fr->box);
+    fr->bPrec = (packed->natoms > 9);
+    fr->prec  = packed->precision;
+    return true;
+}
+
 static void sort_files(gmx::ArrayRef<std::string> files, real* settime)
 {
     for (gmx::index i = 0; i < files.ssize(); i++)
@@ -422,6 +450,9 @@ int gmx_trjcat(int argc, char* argv[])
         "such that a command like [TT]gmx trjcat -f *.trr -o fixed.trr[tt] should do ",
         "the trick. Using [TT]-cat[tt], you can simply paste several files ",
         "together without removal of frames with identical time stamps.[PAR]",
+        "When both input and output are [REF].xtc[ref] files and no index group",
+        "is selected, frames are copied without decompressing the coordinates,",
+        "only the time and step in the frame headers are changed.[PAR]",
         "One important option is inferred when the output file is amongst the",
         "input files. In that case that particular file will be appended to",
         "which implies you do not need to store double the amount of data.",
@@ -638,6 +669,12 @@ int gmx_trjcat(int argc, char* argv[])
         /* Not checking input format, could be dangerous :-) */
         /* Not checking output format, equally dangerous :-) */
 
+        /* Without atom selection, XTC frames can be copied without
+         * decompressing and recompressing the coordinates.
+         */
+        const bool bCopyPacked = (ftpin == efXTC && ftpout == efXTC && !bIndex);
+        t_xtc_packed_frame packed;
+
         frame     = -1;
         frame_out = -1;
         /* the default is not to change the time at all,
@@ -812,7 +849,20 @@ int gmx_trjcat(int argc, char* argv[])
             {
                 timestep = timest[i];
             }
-            read_first_frame(oenv, &status, inFilesEdited[i].c_str(), &fr, FLAGS);
+            t_fileio* packedIn = nullptr;
+            if (bCopyPacked)
+            {
+                clear_trxframe(&fr, TRUE);
+                packedIn = open_xtc(inFilesEdited[i].c_str(), "r");
+                if (!read_next_packed_frame(packedIn, &packed, &fr))
+                {
+                    gmx_fatal(FARGS, "Reading first frame from %s", inFilesEdited[i].c_str());
+                }
+            }
+            else
+            {
+                read_first_frame(oenv, &status, inFilesEdited[i].c_str(), &fr, FLAGS);
+            }
             if (!fr.bTime)
             {
                 fr.time = 0;
@@ -898,7 +948,16 @@ int gmx_trjcat(int argc, char* argv[])
                             bNewFile = FALSE;
                         }
 
-                        if (bIndex)
+                        if (bCopyPacked)
+                        {
+                            packed.step = frout.step;
+                            packed.time = frout.time;
+                            if (!write_xtc_packed(trx_get_fileio(trxout), &packed))
+                            {
+                                gmx_fatal(FARGS, "Error writing frame to %s", out_file);
+                            }
+                        }
+                        else if (bIndex)
                         {
                             write_trxframe_indexed(trxout, &frout, isize, index, nullptr);
                         }
@@ -914,9 +973,17 @@ int gmx_trjcat(int argc, char* argv[])
                         }
                     }
                 }
-            } while (read_next_frame(oenv, status, &fr));
+            } while (bCopyPacked ? read_next_packed_frame(packedIn, &packed, &fr)
+                                 : read_next_frame(oenv, status, &fr));
 
-            close_trx(status);
+            if (bCopyPacked)
+            {
+                close_xtc(packedIn);
+            }
+            else
+            {
+                close_trx(status);
+            }
         }
         if (trxout)
         {
@@ -968,6 +968,11 @@ int gmx_trjconv(int argc, char* argv[])
                 }
             }
 
+            /* Decode the following frames on a separate thread while
+             * the current frame is processed and written.
+             */
+            trx_set_read_ahead(trxin, oenv, &fr, trx_read_ahead_from_environment());
+
             /* Start the big loop over frames */
             file_nr  = 0;
             frame    = 0;
@@ -108,6 +108,13 @@ enum SurfaceType
 };
 //! String values corresponding to SurfaceType.
 const char* const c_SurfaceEnum[] = { "no", "mol", "res" };
+/*! \brief
+ * Number of pair distances that are passed to the histogram in one point set.
+ *
+ * Passing distances in blocks keeps the per-point overhead of the data
+ * framework out of the pair search loop.
+ */
+const int c_pairDistBlockSize = 64;
 
 /*! \brief
  * Implements `gmx rdf` trajectory analysis module.
@@ -152,9 +159,10 @@ private:
     /*! \brief
      * Raw pairwise distance data from which the RDF is computed.
      *
-     * There is a data set for each selection in `sel_`, with a single
-     * column.  Each point set will contain a single pairwise distance
-     * that contributes to the RDF.
+     * There is a data set for each selection in `sel_`, with
+     * `c_pairDistBlockSize` columns.  Each point set contains a block of
+     * pairwise distances that contribute to the RDF; unused columns in the
+     * last point set of a frame are not present.
      */
     AnalysisData pairDist_;
     /*! \brief
@@ -351,7 +359,7 @@ void Rdf::initAnalysis(const TrajectoryAnalysisSettings& settings, const Topolog
     pairDist_.setDataSetCount(sel_.size());
     for (size_t i = 0; i < sel_.size(); ++i)
     {
-        pairDist_.setColumnCount(i, 1);
+        pairDist_.setColumnCount(i, c_pairDistBlockSize);
     }
     plotSettings_ = settings.plotSettings();
     nb_.setXYMode(bXY_);
@@ -445,6 +453,40 @@ public:
         TrajectoryAnalysisModuleData(module, opt, selections)
     {
         surfaceDist2_.resize(surfaceGroupCount);
+        pairDist2_.reserve(c_pairDistBlockSize);
+    }
+
+    /*! \brief
+     * Buffers a squared pair distance, passing a full block to \p dh.
+     */
+    void addPairDistance2(AnalysisDataHandle* dh, real r2)
+    {
+        pairDist2_.push_back(r2);
+        if (pairDist2_.size() == c_pairDistBlockSize)
+        {
+            flushPairDistances(dh);
+        }
+    }
+    /*! \brief
+     * Passes the buffered pair distances to \p dh as a single point set.
+     */
+    void flushPairDistances(AnalysisDataHandle* dh)
+    {
+        if (pairDist2_.empty())
+        {
+            return;
+        }
+        // Separate loop for the square roots so that it can be vectorized.
+        for (real& r : pairDist2_)
+        {
+            r = std::sqrt(r);
+        }
+        for (size_t i = 0; i < pairDist2_.size(); ++i)
+        {
+            dh->setPoint(i, pairDist2_[i]);
+        }
+        dh->finishPointSet();
+        pairDist2_.clear();
     }
 
     void finish() override { finishDataHandles(); }
@@ -461,6 +503,10 @@ public:
      * the RDF from these numbers.
      */
     std::vector<real> surfaceDist2_;
+
+private:
+    //! Squared pair distances not yet passed to the histogram.
+    std::vector<real> pairDist2_;
 };
 
 TrajectoryAnalysisModuleDataPointer Rdf::startFrames(const AnalysisDataParallelOptions& opt,
@@ -555,8 +601,7 @@ void Rdf::analyzeFrame(int frnr, const t_trxframe& fr, t_pbc* pbc, TrajectoryAna
                     // surface positions.
                     if (r2 > cut2_ && r2 <= rmax2_)
                     {
-                        dh.setPoint(0, std::sqrt(r2));
-                        dh.finishPointSet();
+                        frameData.addPairDistance2(&dh, r2);
                     }
                 }
             }
@@ -572,13 +617,11 @@ void Rdf::analyzeFrame(int frnr, const t_trxframe& fr, t_pbc* pbc, TrajectoryAna
                 const real r2 = pair.distance2();
                 if (r2 > cut2_)
                 {
-                    // TODO: Consider whether the histogramming could be done with
-                    // less overhead (after first measuring the overhead).
-                    dh.setPoint(0, std::sqrt(r2));
-                    dh.finishPointSet();
+                    frameData.addPairDistance2(&dh, r2);
                 }
             }
         }
+        frameData.flushPairDistances(&dh);
         // Normalization factor for the number density (only used without
         // -surf, but does not hurt to populate otherwise).
         nh.setPoint(g + 1, sel[g].posCount() * inverseVolume);
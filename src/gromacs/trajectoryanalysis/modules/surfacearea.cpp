@@ -51,6 +51,7 @@
 #include "gromacs/math/vec.h"
 #include "gromacs/pbcutil/pbc.h"
 #include "gromacs/selection/nbsearch.h"
+#include "gromacs/utility/exceptions.h"
 #include "gromacs/utility/fatalerror.h"
 #include "gromacs/utility/gmxassert.h"
 #include "gromacs/utility/smalloc.h"
@@ -580,6 +581,71 @@ static std::vector<real> make_unsp(int densit, int cubus)
     return xus;
 }
 
+namespace
+{
+
+/*! \brief
+ * Surface dots of a single sphere that have not (yet) been found buried.
+ *
+ * The dot coordinates are stored in separate arrays, such that testing all
+ * the dots against a neighbor sphere is a branch-free loop that the compiler
+ * can vectorize.  Buried dots are removed in place, which keeps the
+ * remaining dots in their original order and makes each subsequent
+ * neighbor cheaper to test.
+ */
+class SurfaceDots
+{
+public:
+    explicit SurfaceDots(int n_dot) : x_(n_dot), y_(n_dot), z_(n_dot), count_(0) {}
+
+    //! Restores all the unit sphere dots in \p xus.
+    void reset(const real* xus)
+    {
+        count_ = static_cast<int>(x_.size());
+        for (int j = 0; j < count_; ++j)
+        {
+            x_[j] = xus[3 * j];
+            y_[j] = xus[3 * j + 1];
+            z_[j] = xus[3 * j + 2];
+        }
+    }
+
+    //! Removes the dots for which the projection on \p dx exceeds \p refdot.
+    void removeBuried(const rvec dx, real refdot)
+    {
+        real* gmx_restrict x = x_.data();
+        real* gmx_restrict y = y_.data();
+        real* gmx_restrict z = z_.data();
+        int                n = 0;
+        for (int j = 0; j < count_; ++j)
+        {
+            const bool bExposed = (x[j] * dx[XX] + y[j] * dx[YY] + z[j] * dx[ZZ] <= refdot);
+            x[n]                = x[j];
+            y[n]                = y[j];
+            z[n]                = z[j];
+            n += bExposed ? 1 : 0;
+        }
+        count_ = n;
+    }
+
+    //! Returns the number of remaining dots.
+    int count() const { return count_; }
+    //! Returns the coordinates of remaining dot \p j.
+    real x(int j) const { return x_[j]; }
+    //! \copydoc x()
+    real y(int j) const { return y_[j]; }
+    //! \copydoc x()
+    real z(int j) const { return z_[j]; }
+
+private:
+    std::vector<real> x_;
+    std::vector<real> y_;
+    std::vector<real> z_;
+    int               count_;
+};
+
+} // namespace
+
 static void nsc_dclm_pbc(const rvec*                 coords,
                          const ArrayRef<const real>& radius,
                          int                         nat,
@@ -649,90 +715,89 @@ static void nsc_dclm_pbc(const rvec*                 coords,
     pos.indexed(constArrayRefFromArray(index, nat));
     AnalysisNeighborhoodSearch nbsearch(nb->initSearch(pbc, pos));
 
-    std::vector<int> wkdot(n_dot);
+    // The per-atom contributions are stored and summed afterwards in atom
+    // order, so the result does not depend on the number of threads.
+    std::vector<real> atomArea(nat);
+    std::vector<real> atomVolume((mode & FLAG_VOLUME) ? nat : 0);
 
-    for (int i = 0; i < nat; ++i)
+    // The surface dot output is written in atom order, so it is not
+    // computed in parallel.
+#pragma omp parallel if (!(mode & FLAG_DOTS))
     {
-        const int                      iat  = index[i];
-        const real                     ai   = radius[iat];
-        const real                     aisq = ai * ai;
-        AnalysisNeighborhoodPairSearch pairSearch(nbsearch.startPairSearch(coords[iat]));
-        AnalysisNeighborhoodPair       pair;
-        std::fill(wkdot.begin(), wkdot.end(), 1);
-        int currDotCount = n_dot;
-        while (currDotCount > 0 && pairSearch.findNextPair(&pair))
+        try
         {
-            const int  jat = index[pair.refIndex()];
-            const real aj  = radius[jat];
-            const real d2  = pair.distance2();
-            if (iat == jat || d2 > gmx::square(ai + aj))
-            {
-                continue;
-            }
-            const rvec& dx     = pair.dx();
-            const real  refdot = (d2 + aisq - aj * aj) / (2 * ai);
-            // TODO: Consider whether micro-optimizations from the old
-            // implementation would be useful, compared to the complexity that
-            // they bring: instead of this direct loop, the neighbors were
-            // stored into a temporary array, the loop order was
-            // reversed (first over dots, then over neighbors), and for each
-            // dot, it was first checked whether the same neighbor that
-            // resulted in marking the previous dot covered would also cover
-            // this dot. This presumably plays together with sorting of the
-            // surface dots (done in make_unsp) to avoid some of the looping.
-            // Alternatively, we could keep a skip list here to avoid
-            // repeatedly looping over dots that have already marked as
-            // covered.
-            for (int j = 0; j < n_dot; ++j)
+            SurfaceDots surfaceDots(n_dot);
+
+#pragma omp for schedule(dynamic, 64)
+            for (int i = 0; i < nat; ++i)
             {
-                if (wkdot[j] && iprod(&xus[3 * j], dx) > refdot)
+                const int                      iat  = index[i];
+                const real                     ai   = radius[iat];
+                const real                     aisq = ai * ai;
+                AnalysisNeighborhoodPairSearch pairSearch(nbsearch.startPairSearch(coords[iat]));
+                AnalysisNeighborhoodPair       pair;
+                surfaceDots.reset(xus);
+                while (surfaceDots.count() > 0 && pairSearch.findNextPair(&pair))
                 {
-                    --currDotCount;
-                    wkdot[j] = 0;
+                    const int  jat = index[pair.refIndex()];
+                    const real aj  = radius[jat];
+                    const real d2  = pair.distance2();
+                    if (iat == jat || d2 > gmx::square(ai + aj))
+                    {
+                        continue;
+                    }
+                    const real refdot = (d2 + aisq - aj * aj) / (2 * ai);
+                    surfaceDots.removeBuried(pair.dx(), refdot);
                 }
-            }
-        }
 
-        const real a = aisq * dotarea * currDotCount;
-        area         = area + a;
-        if (mode & FLAG_ATOM_AREA)
-        {
-            atom_area[i] = a;
-        }
-        const real xi = coords[iat][XX];
-        const real yi = coords[iat][YY];
-        const real zi = coords[iat][ZZ];
-        if (mode & FLAG_DOTS)
-        {
-            for (int l = 0; l < n_dot; l++)
-            {
-                if (wkdot[l])
+                const int currDotCount = surfaceDots.count();
+                atomArea[i]            = aisq * dotarea * currDotCount;
+                const real xi          = coords[iat][XX];
+                const real yi          = coords[iat][YY];
+                const real zi          = coords[iat][ZZ];
+                if (mode & FLAG_DOTS)
+                {
+                    for (int l = 0; l < currDotCount; l++)
+                    {
+                        lfnr++;
+                        if (maxdots <= 3 * lfnr + 1)
+                        {
+                            maxdots = maxdots + n_dot * 3;
+                            srenew(dots, maxdots);
+                        }
+                        dots[3 * lfnr - 3] = ai * surfaceDots.x(l) + xi;
+                        dots[3 * lfnr - 2] = ai * surfaceDots.y(l) + yi;
+                        dots[3 * lfnr - 1] = ai * surfaceDots.z(l) + zi;
+                    }
+                }
+                if (mode & FLAG_VOLUME)
                 {
-                    lfnr++;
-                    if (maxdots <= 3 * lfnr + 1)
+                    real dx = 0.0, dy = 0.0, dz = 0.0;
+                    for (int l = 0; l < currDotCount; l++)
                     {
-                        maxdots = maxdots + n_dot * 3;
-                        srenew(dots, maxdots);
+                        dx = dx + surfaceDots.x(l);
+                        dy = dy + surfaceDots.y(l);
+                        dz = dz + surfaceDots.z(l);
                     }
-                    dots[3 * lfnr - 3] = ai * xus[3 * l] + xi;
-                    dots[3 * lfnr - 2] = ai * xus[1 + 3 * l] + yi;
-                    dots[3 * lfnr - 1] = ai * xus[2 + 3 * l] + zi;
+                    atomVolume[i] = aisq
+                                    * (dx * (xi - xs) + dy * (yi - ys) + dz * (zi - zs)
+                                       + ai * currDotCount);
                 }
             }
         }
+        GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR
+    }
+
+    for (int i = 0; i < nat; ++i)
+    {
+        area = area + atomArea[i];
+        if (mode & FLAG_ATOM_AREA)
+        {
+            atom_area[i] = atomArea[i];
+        }
         if (mode & FLAG_VOLUME)
         {
-            real dx = 0.0, dy = 0.0, dz = 0.0;
-            for (int l = 0; l < n_dot; l++)
-            {
-                if (wkdot[l])
-                {
-                    dx = dx + xus[3 * l];
-                    dy = dy + xus[1 + 3 * l];
-                    dz = dz + xus[2 + 3 * l];
-                }
-            }
-            vol = vol + aisq * (dx * (xi - xs) + dy * (yi - ys) + dz * (zi - zs) + ai * currDotCount);
+            vol = vol + atomVolume[i];
         }
     }
 
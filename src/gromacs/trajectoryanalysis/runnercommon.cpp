@@ -223,6 +223,7 @@ void TrajectoryAnalysisRunnerCommon::Impl::initFirstFrame()
             GMX_THROW(FileIOError("Could not read coordinates from trajectory"));
         }
         bTrajOpen_ = true;
+        trx_set_read_ahead(status_, oenv_, fr, trx_read_ahead_from_environment());
 
         if (topInfo_.hasTopology())
         {
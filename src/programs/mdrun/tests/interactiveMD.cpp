@@ -42,10 +42,22 @@
  */
 #include "gmxpre.h"
 
+#include "config.h"
+
+#include <chrono>
+#include <thread>
+
 #include "gromacs/utility/stringutil.h"
 
 #include "moduletest.h"
 
+#if GMX_IMD && !GMX_NATIVE_WINDOWS
+#    include <unistd.h>
+#    include <arpa/inet.h>
+#    include <netinet/in.h>
+#    include <sys/socket.h>
+#endif
+
 namespace gmx
 {
 namespace test
@@ -110,5 +122,162 @@ TEST_P(ImdTest, ImdCanRun)
 // cover the whole space.
 INSTANTIATE_TEST_CASE_P(WithIntegrator, ImdTest, ::testing::Values("md", "steep"));
 
+#if GMX_IMD && !GMX_NATIVE_WINDOWS
+
+//! Returns a TCP port that is currently free, or 0 when none was found.
+static int findFreePort()
+{
+    int port   = 0;
+    int sockfd = socket(AF_INET, SOCK_STREAM, 0);
+    if (sockfd >= 0)
+    {
+        sockaddr_in address     = {};
+        address.sin_family      = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_ANY);
+        socklen_t length        = sizeof(address);
+        if (bind(sockfd, reinterpret_cast<sockaddr*>(&address), length) == 0
+            && getsockname(sockfd, reinterpret_cast<sockaddr*>(&address), &length) == 0)
+        {
+            port = ntohs(address.sin_port);
+        }
+        close(sockfd);
+    }
+    return port;
+}
+
+/*! \brief Minimal IMD client that connects to mdrun on the local host.
+ *
+ * Implements just enough of the IMD protocol to start a session.
+ */
+class ImdTestClient
+{
+public:
+    //! Connects to \p port, retrying while mdrun sets up its socket.
+    explicit ImdTestClient(int port)
+    {
+        for (int attempt = 0; attempt < 600 && sockfd_ < 0; attempt++)
+        {
+            int sockfd = socket(AF_INET, SOCK_STREAM, 0);
+            /* Keep the receive buffer small, so the mdrun side fills up quickly */
+            int receiveBufferSize = 4096;
+            setsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, &receiveBufferSize,
+                       sizeof(receiveBufferSize));
+#    if defined(SO_NOSIGPIPE)
+            /* Where send() has no MSG_NOSIGNAL, disable SIGPIPE on the socket instead */
+            int noSigPipe = 1;
+            setsockopt(sockfd, SOL_SOCKET, SO_NOSIGPIPE, &noSigPipe, sizeof(noSigPipe));
+#    endif
+            sockaddr_in address     = {};
+            address.sin_family      = AF_INET;
+            address.sin_port        = htons(port);
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            if (connect(sockfd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0)
+            {
+                sockfd_ = sockfd;
+            }
+            else
+            {
+                close(sockfd);
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            }
+        }
+    }
+    ~ImdTestClient()
+    {
+        if (sockfd_ >= 0)
+        {
+            close(sockfd_);
+        }
+    }
+    //! Returns whether the client is connected.
+    bool isConnected() const { return sockfd_ >= 0; }
+    //! Reads an IMD header, returns its type or -1 on error.
+    int readHeaderType()
+    {
+        int32_t header[2];
+        size_t  numRead = 0;
+        while (numRead < sizeof(header))
+        {
+            ssize_t ret = read(sockfd_, reinterpret_cast<char*>(header) + numRead,
+                               sizeof(header) - numRead);
+            if (ret <= 0)
+            {
+                return -1;
+            }
+            numRead += ret;
+        }
+        return ntohl(header[0]);
+    }
+    //! Sends an IMD header without payload, returns whether that succeeded.
+    bool sendHeader(int32_t type)
+    {
+        const int32_t header[2] = { static_cast<int32_t>(htonl(type)), 0 };
+#    if defined(MSG_NOSIGNAL)
+        /* Sending to mdrun after it closed the socket should fail, not raise SIGPIPE */
+        return send(sockfd_, header, sizeof(header), MSG_NOSIGNAL) == sizeof(header);
+#    else
+        return send(sockfd_, header, sizeof(header), 0) == sizeof(header);
+#    endif
+    }
+
+private:
+    //! The socket connected to mdrun.
+    int sockfd_ = -1;
+};
+
+//! IMD message types used by the test client, from the IMD protocol.
+enum
+{
+    c_imdGo        = 3,
+    c_imdHandshake = 4
+};
+
+//! Test fixture for mdrun with an IMD client connected
+typedef gmx::test::MdrunTestFixture ImdClientTest;
+
+/* This test checks that mdrun finishes when an IMD client stops reading.
+ * Positions are sent on a separate thread, which blocks on the full socket
+ * while the client does not read, and which must still be stopped when
+ * mdrun disconnects the client at the end of the run.
+ */
+TEST_F(ImdClientTest, MdrunFinishesWhenClientStopsReading)
+{
+    runner_.useTopGroAndNdxFromDatabase("argon5832");
+    runner_.useStringAsMdpFile(R"(
+        dt            = 0.005
+        nsteps        = 500
+        cutoff-scheme = Verlet
+        IMD-group     = System
+    )");
+    EXPECT_EQ(0, runner_.callGrompp());
+
+    const int port = findFreePort();
+    ASSERT_NE(0, port) << "Could not find a free port for IMD";
+
+    ::gmx::test::CommandLine imdCaller;
+    imdCaller.addOption("-imdport", port);
+    imdCaller.append("-imdwait");
+
+    int         mdrunResult = -1;
+    std::thread mdrunThread([this, &imdCaller, &mdrunResult]() {
+        mdrunResult = runner_.callMdrun(imdCaller);
+    });
+
+    {
+        ImdTestClient client(port);
+        EXPECT_TRUE(client.isConnected());
+        if (client.isConnected())
+        {
+            EXPECT_EQ(c_imdHandshake, client.readHeaderType());
+            EXPECT_TRUE(client.sendHeader(c_imdGo));
+        }
+        /* Keep the connection open without reading until mdrun is done */
+        mdrunThread.join();
+    }
+    EXPECT_EQ(0, mdrunResult);
+}
+
+#endif
+
 } // namespace test
 } // namespace gmx